@@ -0,0 +1,106 @@
+#include "AtomicFile.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+AtomicFile::AtomicFile(const std::string &filename)
+  : target(filename), descriptor(-1), committed(false) {
+  // replace the file a link points to, not the link
+  if (char *resolved = realpath(filename.c_str(), nullptr)) {
+    target = resolved;
+    std::free(resolved);
+  }
+  std::size_t slash = target.rfind('/');
+  directory = (slash == std::string::npos ? "./"
+               : target.substr(0, slash + 1));
+  // (slash + 1 is 0 if there is no slash)
+  temporary = directory + "." + target.substr(slash + 1) + ".femto-XXXXXX";
+  descriptor = mkstemp(&temporary[0]);
+  if (descriptor == -1) {
+    fail("Cannot create a temporary file");
+    temporary.clear();
+    return;
+  }
+  struct stat info;
+  if (stat(target.c_str(), &info) == 0) {
+    fchmod(descriptor, info.st_mode & 07777);
+  }
+}
+
+AtomicFile::~AtomicFile() {
+  if (descriptor != -1) {
+    close(descriptor);
+  }
+  if (!committed && !temporary.empty()) {
+    unlink(temporary.c_str());
+  }
+}
+
+const std::string & AtomicFile::error() const {
+  return failure;
+}
+
+bool AtomicFile::write(const char *data, std::size_t count) {
+  if (!failure.empty()) {
+    return false;
+  }
+  while (count > 0) {
+    ssize_t written = ::write(descriptor, data, count);
+    if (written == -1 && errno != EINTR) {
+      return fail("Cannot write");
+    } else if (written > 0) {
+      data += written;
+      count -= written;
+    }
+  }
+  return true;
+}
+
+bool AtomicFile::commit(bool sync) {
+  if (!failure.empty()) {
+    return false;
+  }
+  if (sync && fsync(descriptor) != 0) {
+    return fail("Cannot sync");
+  }
+  int result = close(descriptor);
+  descriptor = -1;
+  if (result != 0) {
+    return fail("Cannot write");
+  }
+  if (rename(temporary.c_str(), target.c_str()) != 0) {
+    return fail("Cannot replace the file");
+  }
+  committed = true;
+  if (sync) {
+    // make the rename itself durable
+    int parent = open(directory.c_str(), O_RDONLY);
+    if (parent != -1) {
+      fsync(parent);
+      close(parent);
+    }
+  }
+  return true;
+}
+
+bool AtomicFile::fail(const std::string &what) {
+  if (failure.empty()) {
+    failure = what + ": " + std::strerror(errno);
+  }
+  return false;
+}
+
+bool save_text(const TextBuffer &text, const std::string &filename,
+               bool sync, std::string &error) {
+  AtomicFile file(filename);
+  text.visit(0, text.size(), [&](const char *block,
+                                 TextBuffer::Position count) {
+    return file.write(block, count);
+  });
+  bool saved = file.commit(sync);
+  error = file.error();
+  return saved;
+}
@@ -0,0 +1,69 @@
+#ifndef ATOMIC_FILE_HPP
+#define ATOMIC_FILE_HPP
+/* AtomicFile.hpp
+ *
+ * Replaces a file atomically: the new contents are written to a
+ * temporary file in the same directory, which is renamed over the file
+ * only once it is complete. A crash while saving thus leaves either the
+ * old or the new file, never a truncated one. The temporary file may be
+ * synced to disk before the rename, so that the new contents also
+ * survive a power failure.
+ *
+ * EECS 280 List/Editor Project
+ */
+
+#include <cstddef>
+#include <string>
+#include "TextBuffer.hpp"
+
+class AtomicFile {
+public:
+  //EFFECTS: Creates a temporary file next to filename (or next to the
+  //         file it links to), with the same permissions as filename if
+  //         it exists. On failure, error() describes the problem.
+  explicit AtomicFile(const std::string &filename);
+
+  //EFFECTS: Removes the temporary file, unless it has been committed.
+  ~AtomicFile();
+
+  AtomicFile(const AtomicFile &) = delete;
+  AtomicFile & operator=(const AtomicFile &) = delete;
+
+  //EFFECTS: Returns a description of the first failure, or an empty
+  //         string if there has been none.
+  const std::string & error() const;
+
+  //REQUIRES: data points to at least count characters
+  //MODIFIES: *this
+  //EFFECTS:  Appends the count characters starting at data to the
+  //          temporary file. Returns whether they were written.
+  bool write(const char *data, std::size_t count);
+
+  //MODIFIES: *this
+  //EFFECTS:  Closes the temporary file and renames it to the filename,
+  //          after syncing it to disk if sync is true. Returns whether
+  //          the file was replaced. Nothing is renamed after a failure.
+  bool commit(bool sync);
+
+private:
+  std::string target;
+  std::string temporary;
+  std::string directory;
+  int descriptor;
+  bool committed;
+  std::string failure;
+
+  //MODIFIES: *this
+  //EFFECTS:  Records what failed, with the system's reason, and returns
+  //          false.
+  bool fail(const std::string &what);
+};
+
+//MODIFIES: the file system
+//EFFECTS:  Writes the contents of text to filename through an AtomicFile,
+//          a block at a time, syncing it to disk if sync is true. Returns
+//          whether it succeeded, and otherwise sets error to the reason.
+bool save_text(const TextBuffer &text, const std::string &filename,
+               bool sync, std::string &error);
+
+#endif // ATOMIC_FILE_HPP
@@ -0,0 +1,112 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "AtomicFile.hpp"
+#include "unit_test_framework.hpp"
+
+using namespace std;
+
+static const char *FILENAME = "AtomicFile_tests.tmp";
+
+// Writes contents to filename.
+static void write_file(const string &filename, const string &contents) {
+  ofstream output(filename, ios::binary);
+  output << contents;
+}
+
+// Returns the contents of filename.
+static string read_file(const string &filename) {
+  ifstream input(filename, ios::binary);
+  ostringstream contents;
+  contents << input.rdbuf();
+  return contents.str();
+}
+
+// Returns the number of temporary files left in the current directory.
+static int count_temporaries() {
+  int count = 0;
+  DIR *directory = opendir(".");
+  while (dirent *entry = readdir(directory)) {
+    if (string(entry->d_name).find(".femto-") != string::npos) {
+      ++count;
+    }
+  }
+  closedir(directory);
+  return count;
+}
+
+TEST(test_commit_replaces) {
+  write_file(FILENAME, "old contents");
+  chmod(FILENAME, 0640);
+  {
+    AtomicFile file(FILENAME);
+    ASSERT_TRUE(file.write("new ", 4));
+    ASSERT_EQUAL(read_file(FILENAME), "old contents");
+    ASSERT_TRUE(file.write("contents", 8));
+    ASSERT_TRUE(file.commit(true));
+    ASSERT_EQUAL(file.error(), "");
+  }
+  ASSERT_EQUAL(read_file(FILENAME), "new contents");
+  struct stat info;
+  stat(FILENAME, &info);
+  ASSERT_EQUAL(info.st_mode & 0777, 0640u);
+  ASSERT_EQUAL(count_temporaries(), 0);
+  remove(FILENAME);
+}
+
+TEST(test_abandon_keeps_file) {
+  write_file(FILENAME, "old contents");
+  {
+    AtomicFile file(FILENAME);
+    file.write("partial", 7);
+  } // e.g. an error while producing the contents
+  ASSERT_EQUAL(read_file(FILENAME), "old contents");
+  ASSERT_EQUAL(count_temporaries(), 0);
+  remove(FILENAME);
+}
+
+TEST(test_replace_through_link) {
+  write_file(FILENAME, "old");
+  symlink(FILENAME, "AtomicFile_tests.link");
+  {
+    AtomicFile file("AtomicFile_tests.link");
+    file.write("new", 3);
+    ASSERT_TRUE(file.commit(false));
+  }
+  struct stat info;
+  lstat("AtomicFile_tests.link", &info);
+  ASSERT_TRUE(S_ISLNK(info.st_mode));
+  ASSERT_EQUAL(read_file(FILENAME), "new");
+  remove("AtomicFile_tests.link");
+  remove(FILENAME);
+}
+
+TEST(test_missing_directory) {
+  AtomicFile file("AtomicFile_tests.missing/file");
+  ASSERT_NOT_EQUAL(file.error(), "");
+  ASSERT_FALSE(file.write("x", 1));
+  ASSERT_FALSE(file.commit(true));
+}
+
+TEST(test_save_text) {
+  string contents;
+  for (int i = 0; contents.size() < 300000; ++i) {
+    contents += "row " + to_string(i) + "\n";
+  }
+  TextBuffer text;
+  text.insert(contents.data(), contents.size());
+  string error;
+  ASSERT_TRUE(save_text(text, FILENAME, true, error));
+  ASSERT_EQUAL(error, "");
+  ASSERT_EQUAL(read_file(FILENAME), contents);
+  ASSERT_FALSE(save_text(text, "AtomicFile_tests.missing/file", true,
+                         error));
+  ASSERT_NOT_EQUAL(error, "");
+  remove(FILENAME);
+}
+
+TEST_MAIN()
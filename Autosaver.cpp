@@ -0,0 +1,105 @@
+#include "Autosaver.hpp"
+#include "AtomicFile.hpp"
+#include <algorithm>
+#include <cstdio>
+
+using Position = TextBuffer::Position;
+
+// Converts seconds to a duration of the clock.
+static Autosaver::clock::duration to_duration(double seconds) {
+  return std::chrono::duration_cast<Autosaver::clock::duration>(
+    std::chrono::duration<double>(seconds));
+}
+
+Autosaver::Autosaver(TextBuffer &text_in, double idle_seconds_in,
+                     double interval_seconds_in)
+  : text(text_in), idle(to_duration(idle_seconds_in)),
+    interval(to_duration(interval_seconds_in)), changed(false),
+    done(false) {
+  observer = text.subscribe([this](const TextBuffer::Edit &) {
+    clock::time_point now = clock::now();
+    if (!changed) {
+      changed = true;
+      first_change = now;
+    }
+    last_change = now;
+  });
+}
+
+Autosaver::~Autosaver() {
+  wait();
+  text.unsubscribe(observer);
+}
+
+void Autosaver::set_path(const std::string &path_in) {
+  wait();
+  autosave_path = path_in;
+}
+
+const std::string & Autosaver::path() const {
+  return autosave_path;
+}
+
+int Autosaver::milliseconds_until_due() const {
+  if (!changed) {
+    return -1;
+  }
+  clock::time_point due = std::min(last_change + idle,
+                                   first_change + interval);
+  auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+    due - clock::now()).count();
+  return std::max<int>(0, remaining);
+}
+
+bool Autosaver::poll() {
+  if (worker.joinable()) {
+    if (!done) {
+      return false;
+    }
+    wait();
+    return true;
+  }
+  if (milliseconds_until_due() == 0) {
+    // the worker writes a copy, since the text may change meanwhile
+    std::string snapshot;
+    snapshot.reserve(text.size());
+    text.visit(0, text.size(), [&](const char *block, Position count) {
+      snapshot.append(block, count);
+      return true;
+    });
+    changed = false;
+    done = false;
+    worker = std::thread(&Autosaver::write, this, autosave_path,
+                         std::move(snapshot));
+  }
+  return false;
+}
+
+bool Autosaver::pending() const {
+  return worker.joinable();
+}
+
+const std::string & Autosaver::error() const {
+  return last_error;
+}
+
+void Autosaver::discard() {
+  wait();
+  changed = false;
+  std::remove(autosave_path.c_str());
+}
+
+void Autosaver::wait() {
+  if (worker.joinable()) {
+    worker.join();
+    last_error = worker_error;
+  }
+}
+
+void Autosaver::write(const std::string &path, const std::string &snapshot) {
+  AtomicFile file(path);
+  file.write(snapshot.data(), snapshot.size());
+  file.commit(true);
+  worker_error = file.error();
+  done = true;
+}
@@ -0,0 +1,105 @@
+#ifndef AUTOSAVER_HPP
+#define AUTOSAVER_HPP
+/* Autosaver.hpp
+ *
+ * Saves snapshots of a TextBuffer to a file in the background, which
+ * the Journal is compacted to. A snapshot is taken once editing
+ * pauses, or periodically during continuous editing, but only if the
+ * text has changed since the last one. The snapshot is copied on the
+ * calling thread and written on a worker thread, so editing continues
+ * while a large buffer is written.
+ *
+ * EECS 280 List/Editor Project
+ */
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include "TextBuffer.hpp"
+
+class Autosaver {
+public:
+  using clock = std::chrono::steady_clock;
+
+  // Default seconds without edits after which a snapshot is taken.
+  static constexpr double IDLE_SECONDS = 2;
+
+  // Default longest time in seconds that edits go without a snapshot
+  // during continuous editing.
+  static constexpr double INTERVAL_SECONDS = 30;
+
+  //MODIFIES: text
+  //EFFECTS:  Creates an autosaver for text, which observes edits to the
+  //          text and saves snapshots to the file set by set_path(). The
+  //          text must outlive the autosaver.
+  Autosaver(TextBuffer &text_in, double idle_seconds_in = IDLE_SECONDS,
+            double interval_seconds_in = INTERVAL_SECONDS);
+
+  //MODIFIES: text
+  //EFFECTS:  Waits for any snapshot being written, and stops observing
+  //          the text. The snapshot file is kept.
+  ~Autosaver();
+
+  Autosaver(const Autosaver &) = delete;
+  Autosaver & operator=(const Autosaver &) = delete;
+
+  //MODIFIES: *this
+  //EFFECTS:  Saves snapshots to the file at path from now on.
+  void set_path(const std::string &path_in);
+
+  //EFFECTS: Returns the name of the file snapshots are saved to.
+  const std::string & path() const;
+
+  //EFFECTS: Returns the number of milliseconds until a snapshot is due,
+  //         or -1 if there are no edits to save.
+  int milliseconds_until_due() const;
+
+  //MODIFIES: *this
+  //EFFECTS:  Collects the snapshot being written if it has finished, or
+  //          else starts writing a new one if it is due. Returns whether
+  //          a snapshot was collected, in which case error() tells
+  //          whether it was written.
+  bool poll();
+
+  //EFFECTS: Returns whether a snapshot is being written.
+  bool pending() const;
+
+  //EFFECTS: Returns the reason the last snapshot collected could not be
+  //         written, or an empty string.
+  const std::string & error() const;
+
+  //MODIFIES: *this, the file system
+  //EFFECTS:  Forgets the edits made so far, which have been saved some
+  //          other way, and removes the snapshot file.
+  void discard();
+
+private:
+  TextBuffer &text;
+  int observer;
+  std::string autosave_path;
+  const clock::duration idle;
+  const clock::duration interval;
+
+  // whether there are edits since the last snapshot, when the first
+  // and last of them were made
+  bool changed;
+  clock::time_point first_change;
+  clock::time_point last_change;
+
+  // the worker, which writes a snapshot and then sets done
+  std::thread worker;
+  std::atomic<bool> done;
+  std::string worker_error;
+  std::string last_error;
+
+  //MODIFIES: *this
+  //EFFECTS:  Waits for the worker, if there is one, and collects it.
+  void wait();
+
+  //MODIFIES: the file system, worker_error, done
+  //EFFECTS:  Writes snapshot to path. Runs on the worker thread.
+  void write(const std::string &path, const std::string &snapshot);
+};
+
+#endif // AUTOSAVER_HPP
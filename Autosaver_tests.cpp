@@ -0,0 +1,100 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "Autosaver.hpp"
+#include "unit_test_framework.hpp"
+
+using namespace std;
+
+static const char *FILENAME = "Autosaver_tests.tmp";
+
+// Returns the contents of filename.
+static string read_file(const string &filename) {
+  ifstream input(filename, ios::binary);
+  ostringstream contents;
+  contents << input.rdbuf();
+  return contents.str();
+}
+
+// Returns whether filename exists.
+static bool exists(const string &filename) {
+  return ifstream(filename).good();
+}
+
+// Polls autosaver until a snapshot is collected.
+static void wait_for(Autosaver &autosaver) {
+  while (!autosaver.poll()) {
+    this_thread::sleep_for(chrono::milliseconds(1));
+  }
+}
+
+TEST(test_saves_when_idle) {
+  TextBuffer text;
+  Autosaver autosaver(text, 0.05, 60);
+  autosaver.set_path(FILENAME);
+  ASSERT_EQUAL(autosaver.milliseconds_until_due(), -1);
+  ASSERT_FALSE(autosaver.poll());
+  text.insert("first", 5);
+  ASSERT_TRUE(autosaver.milliseconds_until_due() > 0);
+  ASSERT_FALSE(autosaver.poll()); // not idle yet
+  ASSERT_FALSE(exists(autosaver.path()));
+  this_thread::sleep_for(chrono::milliseconds(60));
+  ASSERT_EQUAL(autosaver.milliseconds_until_due(), 0);
+  autosaver.poll(); // starts writing a snapshot
+  text.insert(" edit", 5); // after the snapshot
+  wait_for(autosaver);
+  ASSERT_EQUAL(autosaver.error(), "");
+  ASSERT_EQUAL(read_file(autosaver.path()), "first");
+
+  // only the edit after the snapshot is left to save
+  ASSERT_TRUE(autosaver.milliseconds_until_due() > 0);
+  this_thread::sleep_for(chrono::milliseconds(60));
+  autosaver.poll();
+  wait_for(autosaver);
+  ASSERT_EQUAL(read_file(autosaver.path()), "first edit");
+  ASSERT_EQUAL(autosaver.milliseconds_until_due(), -1);
+  ASSERT_FALSE(autosaver.poll());
+
+  autosaver.discard();
+  ASSERT_FALSE(exists(autosaver.path()));
+}
+
+TEST(test_saves_during_continuous_edits) {
+  TextBuffer text;
+  Autosaver autosaver(text, 60, 0.05);
+  autosaver.set_path(FILENAME);
+  for (int i = 0; i < 100 && !exists(autosaver.path()); ++i) {
+    text.insert('x');
+    autosaver.poll();
+    this_thread::sleep_for(chrono::milliseconds(5));
+  }
+  wait_for(autosaver);
+  ASSERT_TRUE(exists(autosaver.path()));
+  autosaver.discard();
+  ASSERT_EQUAL(autosaver.milliseconds_until_due(), -1);
+}
+
+TEST(test_set_path) {
+  TextBuffer text;
+  Autosaver autosaver(text, 0, 60);
+  autosaver.set_path(FILENAME);
+  ASSERT_EQUAL(autosaver.path(), FILENAME);
+  text.insert("x", 1);
+  autosaver.poll();
+  wait_for(autosaver);
+  ASSERT_EQUAL(read_file(FILENAME), "x");
+  autosaver.set_path("Autosaver_tests.other");
+  text.insert("y", 1);
+  autosaver.poll();
+  wait_for(autosaver);
+  ASSERT_EQUAL(read_file("Autosaver_tests.other"), "xy");
+  ASSERT_EQUAL(read_file(FILENAME), "x");
+  autosaver.discard();
+  ASSERT_FALSE(exists("Autosaver_tests.other"));
+  remove(FILENAME);
+}
+
+TEST_MAIN()
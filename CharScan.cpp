@@ -0,0 +1,405 @@
+#include "CharScan.hpp"
+#include <cassert>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define CHARSCAN_X86 1
+#  include <immintrin.h>
+#else
+#  define CHARSCAN_X86 0
+#endif
+
+namespace {
+
+using FindFunction = const char * (*)(const char *, const char *, char);
+using CountFunction = std::size_t (*)(const char *, const char *, char);
+using RangeFunction = const char * (*)(const char *, const char *);
+using TallyFunction = std::size_t (*)(const char *, const char *);
+using PairFunction = const char * (*)(const char *, const char *, char, char,
+                                      std::ptrdiff_t);
+
+// Table of implementations for one instruction set.
+struct ScanFunctions {
+  ScanLevel level;
+  FindFunction find;
+  FindFunction rfind;
+  CountFunction count;
+  PairFunction find_pair;
+  RangeFunction find_non_ascii;
+  TallyFunction count_continuations;
+};
+
+// Returns whether c is a UTF-8 continuation byte (10xxxxxx).
+inline bool is_continuation(char c) {
+  return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+////////////////////////////////////////
+// Scalar fallback
+
+const char * find_scalar(const char *first, const char *last, char c) {
+  const void *found = std::memchr(first, c, last - first);
+  return found ? static_cast<const char *>(found) : last;
+}
+
+const char * rfind_scalar(const char *first, const char *last, char c) {
+  for (const char *p = last; p != first;) {
+    if (*--p == c) {
+      return p;
+    }
+  }
+  return last;
+}
+
+std::size_t count_scalar(const char *first, const char *last, char c) {
+  std::size_t count = 0;
+  for (; first != last; ++first) {
+    count += (*first == c);
+  }
+  return count;
+}
+
+const char * find_pair_scalar(const char *first, const char *last, char a,
+                              char b, std::ptrdiff_t distance) {
+  if (last - first <= distance) {
+    return last;
+  }
+  const char *end = last - distance; // candidates start before end
+  for (const char *p = first;; ++p) {
+    p = find_scalar(p, end, a);
+    if (p == end) {
+      return last;
+    } else if (p[distance] == b) {
+      return p;
+    }
+  }
+}
+
+const char * find_non_ascii_scalar(const char *first, const char *last) {
+  for (; first != last; ++first) {
+    if (static_cast<unsigned char>(*first) > 0x7F) {
+      return first;
+    }
+  }
+  return last;
+}
+
+std::size_t count_continuations_scalar(const char *first, const char *last) {
+  std::size_t count = 0;
+  for (; first != last; ++first) {
+    count += is_continuation(*first);
+  }
+  return count;
+}
+
+#if CHARSCAN_X86
+////////////////////////////////////////
+// SSE2: 16 bytes per step
+
+__attribute__((target("sse2")))
+const char * find_sse2(const char *first, const char *last, char c) {
+  const __m128i needle = _mm_set1_epi8(c);
+  for (; last - first >= 16; first += 16) {
+    __m128i block =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+    if (mask) {
+      return first + __builtin_ctz(mask);
+    }
+  }
+  return find_scalar(first, last, c);
+}
+
+__attribute__((target("sse2")))
+const char * rfind_sse2(const char *first, const char *last, char c) {
+  const __m128i needle = _mm_set1_epi8(c);
+  const char *p = last;
+  for (; p - first >= 16; p -= 16) {
+    __m128i block =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(p - 16));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+    if (mask) {
+      return p - 16 + (31 - __builtin_clz(mask));
+    }
+  }
+  const char *found = rfind_scalar(first, p, c);
+  return found == p ? last : found;
+}
+
+__attribute__((target("sse2")))
+std::size_t count_sse2(const char *first, const char *last, char c) {
+  const __m128i needle = _mm_set1_epi8(c);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i total = zero;
+  while (last - first >= 16) {
+    // per-byte counters saturate after 255 steps, so flush them
+    __m128i counters = zero;
+    for (int steps = 0; steps < 255 && last - first >= 16;
+         ++steps, first += 16) {
+      __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+      // matching bytes compare to -1, so subtracting counts them
+      counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(block, needle));
+    }
+    total = _mm_add_epi64(total, _mm_sad_epu8(counters, zero));
+  }
+  alignas(16) unsigned long long lanes[2];
+  _mm_store_si128(reinterpret_cast<__m128i *>(lanes), total);
+  return lanes[0] + lanes[1] + count_scalar(first, last, c);
+}
+
+__attribute__((target("sse2")))
+const char * find_pair_sse2(const char *first, const char *last, char a,
+                            char b, std::ptrdiff_t distance) {
+  const __m128i first_needle = _mm_set1_epi8(a);
+  const __m128i last_needle = _mm_set1_epi8(b);
+  for (; last - first >= distance + 16; first += 16) {
+    __m128i starts =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+    __m128i ends =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(first + distance));
+    int mask = _mm_movemask_epi8(
+      _mm_and_si128(_mm_cmpeq_epi8(starts, first_needle),
+                    _mm_cmpeq_epi8(ends, last_needle)));
+    if (mask) {
+      return first + __builtin_ctz(mask);
+    }
+  }
+  return find_pair_scalar(first, last, a, b, distance);
+}
+
+__attribute__((target("sse2")))
+const char * find_non_ascii_sse2(const char *first, const char *last) {
+  for (; last - first >= 16; first += 16) {
+    __m128i block =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+    int mask = _mm_movemask_epi8(block); // one bit per high bit
+    if (mask) {
+      return first + __builtin_ctz(mask);
+    }
+  }
+  return find_non_ascii_scalar(first, last);
+}
+
+__attribute__((target("sse2")))
+std::size_t count_continuations_sse2(const char *first, const char *last) {
+  // continuation bytes are exactly the signed bytes below -64
+  const __m128i limit = _mm_set1_epi8(-64);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i total = zero;
+  while (last - first >= 16) {
+    __m128i counters = zero;
+    for (int steps = 0; steps < 255 && last - first >= 16;
+         ++steps, first += 16) {
+      __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+      counters = _mm_sub_epi8(counters, _mm_cmplt_epi8(block, limit));
+    }
+    total = _mm_add_epi64(total, _mm_sad_epu8(counters, zero));
+  }
+  alignas(16) unsigned long long lanes[2];
+  _mm_store_si128(reinterpret_cast<__m128i *>(lanes), total);
+  return lanes[0] + lanes[1] + count_continuations_scalar(first, last);
+}
+
+////////////////////////////////////////
+// AVX2: 32 bytes per step
+
+__attribute__((target("avx2")))
+const char * find_avx2(const char *first, const char *last, char c) {
+  const __m256i needle = _mm256_set1_epi8(c);
+  for (; last - first >= 32; first += 32) {
+    __m256i block =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+    unsigned mask = static_cast<unsigned>(
+      _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+    if (mask) {
+      return first + __builtin_ctz(mask);
+    }
+  }
+  return find_sse2(first, last, c);
+}
+
+__attribute__((target("avx2")))
+const char * rfind_avx2(const char *first, const char *last, char c) {
+  const __m256i needle = _mm256_set1_epi8(c);
+  const char *p = last;
+  for (; p - first >= 32; p -= 32) {
+    __m256i block =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p - 32));
+    unsigned mask = static_cast<unsigned>(
+      _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+    if (mask) {
+      return p - 32 + (31 - __builtin_clz(mask));
+    }
+  }
+  const char *found = rfind_sse2(first, p, c);
+  return found == p ? last : found;
+}
+
+__attribute__((target("avx2")))
+std::size_t count_avx2(const char *first, const char *last, char c) {
+  const __m256i needle = _mm256_set1_epi8(c);
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i total = zero;
+  while (last - first >= 32) {
+    __m256i counters = zero;
+    for (int steps = 0; steps < 255 && last - first >= 32;
+         ++steps, first += 32) {
+      __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+      counters =
+        _mm256_sub_epi8(counters, _mm256_cmpeq_epi8(block, needle));
+    }
+    total = _mm256_add_epi64(total, _mm256_sad_epu8(counters, zero));
+  }
+  alignas(32) unsigned long long lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), total);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3]
+    + count_sse2(first, last, c);
+}
+
+__attribute__((target("avx2")))
+const char * find_pair_avx2(const char *first, const char *last, char a,
+                            char b, std::ptrdiff_t distance) {
+  const __m256i first_needle = _mm256_set1_epi8(a);
+  const __m256i last_needle = _mm256_set1_epi8(b);
+  for (; last - first >= distance + 32; first += 32) {
+    __m256i starts =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+    __m256i ends =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first + distance));
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+      _mm256_and_si256(_mm256_cmpeq_epi8(starts, first_needle),
+                       _mm256_cmpeq_epi8(ends, last_needle))));
+    if (mask) {
+      return first + __builtin_ctz(mask);
+    }
+  }
+  return find_pair_sse2(first, last, a, b, distance);
+}
+
+__attribute__((target("avx2")))
+const char * find_non_ascii_avx2(const char *first, const char *last) {
+  for (; last - first >= 32; first += 32) {
+    __m256i block =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(block));
+    if (mask) {
+      return first + __builtin_ctz(mask);
+    }
+  }
+  return find_non_ascii_sse2(first, last);
+}
+
+__attribute__((target("avx2")))
+std::size_t count_continuations_avx2(const char *first, const char *last) {
+  const __m256i limit = _mm256_set1_epi8(-64);
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i total = zero;
+  while (last - first >= 32) {
+    __m256i counters = zero;
+    for (int steps = 0; steps < 255 && last - first >= 32;
+         ++steps, first += 32) {
+      __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+      counters =
+        _mm256_sub_epi8(counters, _mm256_cmpgt_epi8(limit, block));
+    }
+    total = _mm256_add_epi64(total, _mm256_sad_epu8(counters, zero));
+  }
+  alignas(32) unsigned long long lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), total);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3]
+    + count_continuations_sse2(first, last);
+}
+#endif // CHARSCAN_X86
+
+const ScanFunctions SCALAR_FUNCTIONS = {
+  ScanLevel::SCALAR, find_scalar, rfind_scalar, count_scalar,
+  find_pair_scalar, find_non_ascii_scalar, count_continuations_scalar
+};
+#if CHARSCAN_X86
+const ScanFunctions SSE2_FUNCTIONS = {
+  ScanLevel::SSE2, find_sse2, rfind_sse2, count_sse2, find_pair_sse2,
+  find_non_ascii_sse2, count_continuations_sse2
+};
+const ScanFunctions AVX2_FUNCTIONS = {
+  ScanLevel::AVX2, find_avx2, rfind_avx2, count_avx2, find_pair_avx2,
+  find_non_ascii_avx2, count_continuations_avx2
+};
+#endif
+
+// Queries CPUID for the widest supported instruction set.
+ScanLevel detect_scan_level() {
+#if CHARSCAN_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return ScanLevel::AVX2;
+  } else if (__builtin_cpu_supports("sse2")) {
+    return ScanLevel::SSE2;
+  }
+#endif
+  return ScanLevel::SCALAR;
+}
+
+const ScanFunctions & functions_for(ScanLevel level) {
+#if CHARSCAN_X86
+  if (level == ScanLevel::AVX2) {
+    return AVX2_FUNCTIONS;
+  } else if (level == ScanLevel::SSE2) {
+    return SSE2_FUNCTIONS;
+  }
+#endif
+  return SCALAR_FUNCTIONS;
+}
+
+// The selected implementation, initialized on first use.
+const ScanFunctions *& current_functions() {
+  static const ScanFunctions *current = &functions_for(max_scan_level());
+  return current;
+}
+
+} // namespace
+
+ScanLevel scan_level() {
+  return current_functions()->level;
+}
+
+ScanLevel max_scan_level() {
+  static const ScanLevel level = detect_scan_level();
+  return level;
+}
+
+void set_scan_level(ScanLevel level) {
+  assert(level <= max_scan_level());
+  current_functions() = &functions_for(level);
+}
+
+const char * find_char(const char *first, const char *last, char c) {
+  return current_functions()->find(first, last, c);
+}
+
+const char * rfind_char(const char *first, const char *last, char c) {
+  return current_functions()->rfind(first, last, c);
+}
+
+std::size_t count_char(const char *first, const char *last, char c) {
+  return current_functions()->count(first, last, c);
+}
+
+const char * find_pair(const char *first, const char *last, char a, char b,
+                       std::ptrdiff_t distance) {
+  return current_functions()->find_pair(first, last, a, b, distance);
+}
+
+const char * find_non_ascii(const char *first, const char *last) {
+  return current_functions()->find_non_ascii(first, last);
+}
+
+std::size_t count_codepoints(const char *first, const char *last) {
+  // ASCII runs consist of lead bytes only
+  const char *non_ascii = find_non_ascii(first, last);
+  return (last - first)
+    - current_functions()->count_continuations(non_ascii, last);
+}
@@ -0,0 +1,70 @@
+#ifndef CHARSCAN_HPP
+#define CHARSCAN_HPP
+/* CharScan.hpp
+ *
+ * Scanning primitives over contiguous character ranges, used for bulk
+ * operations on text (file loading, bulk insertion, row and UTF-8
+ * column counting).
+ * The implementation is vectorized with SSE2 or AVX2 where available,
+ * with a scalar fallback. The widest supported instruction set is
+ * selected at runtime via CPUID.
+ *
+ * EECS 280 List/Editor Project
+ */
+
+#include <cstddef>
+
+// Instruction sets that the scanning primitives can be implemented with.
+enum class ScanLevel {
+  SCALAR,
+  SSE2,
+  AVX2
+};
+
+//EFFECTS: Returns the instruction set currently used for scanning.
+ScanLevel scan_level();
+
+//EFFECTS: Returns the widest instruction set supported by this machine.
+ScanLevel max_scan_level();
+
+//REQUIRES: level <= max_scan_level()
+//MODIFIES: the implementation used by all scanning functions
+//EFFECTS:  Selects the instruction set used for scanning. Intended for
+//          tests and benchmarks that compare implementations.
+void set_scan_level(ScanLevel level);
+
+//REQUIRES: [first, last) is a valid range
+//EFFECTS:  Returns a pointer to the first occurrence of c in the range,
+//          or last if there is none.
+const char * find_char(const char *first, const char *last, char c);
+
+//REQUIRES: [first, last) is a valid range
+//EFFECTS:  Returns a pointer to the last occurrence of c in the range,
+//          or last if there is none.
+const char * rfind_char(const char *first, const char *last, char c);
+
+//REQUIRES: [first, last) is a valid range
+//EFFECTS:  Returns the number of occurrences of c in the range.
+std::size_t count_char(const char *first, const char *last, char c);
+
+//REQUIRES: [first, last) is a valid range, and distance >= 0
+//EFFECTS:  Returns a pointer to the first p in the range such that
+//          p[0] == a and p[distance] == b, with p + distance also in the
+//          range, or last if there is none. Used to find candidate
+//          matches of short patterns by their first and last bytes.
+const char * find_pair(const char *first, const char *last, char a, char b,
+                       std::ptrdiff_t distance);
+
+//REQUIRES: [first, last) is a valid range
+//EFFECTS:  Returns a pointer to the first byte in the range that is not
+//          ASCII (has its high bit set), or last if there is none.
+const char * find_non_ascii(const char *first, const char *last);
+
+//REQUIRES: [first, last) is a valid range
+//EFFECTS:  Returns the number of bytes in the range that are not UTF-8
+//          continuation bytes (10xxxxxx), i.e. the number of codepoints
+//          that start in the range. ASCII-only runs are skipped with a
+//          vectorized high-bit check.
+std::size_t count_codepoints(const char *first, const char *last);
+
+#endif // CHARSCAN_HPP
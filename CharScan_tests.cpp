@@ -0,0 +1,161 @@
+#include <string>
+#include <vector>
+#include "CharScan.hpp"
+#include "unit_test_framework.hpp"
+
+using namespace std;
+
+// Returns every scan level supported on this machine.
+static vector<ScanLevel> supported_levels() {
+  vector<ScanLevel> levels = { ScanLevel::SCALAR };
+  if (max_scan_level() >= ScanLevel::SSE2) {
+    levels.push_back(ScanLevel::SSE2);
+  }
+  if (max_scan_level() >= ScanLevel::AVX2) {
+    levels.push_back(ScanLevel::AVX2);
+  }
+  return levels;
+}
+
+// Builds a string whose newlines are at irregular positions, so that
+// they land in every lane of a vector and in the scalar tails.
+static string sample_text(size_t length) {
+  string text;
+  for (size_t i = 0; i < length; ++i) {
+    text.push_back((i * i + 3 * i) % 37 == 0 ? '\n' : 'a' + i % 26);
+  }
+  return text;
+}
+
+TEST(test_default_level) {
+  ASSERT_TRUE(scan_level() == max_scan_level());
+}
+
+TEST(test_find_char) {
+  for (ScanLevel level : supported_levels()) {
+    set_scan_level(level);
+    for (size_t length = 0; length < 200; ++length) {
+      string text = sample_text(length);
+      const char *first = text.data(), *last = first + length;
+      for (size_t start = 0; start <= length; start += 7) {
+        size_t expected = text.find('\n', start);
+        const char *found = find_char(first + start, last, '\n');
+        ASSERT_EQUAL(found - first, expected == string::npos ? length
+                                                             : expected);
+      }
+    }
+  }
+  set_scan_level(max_scan_level());
+}
+
+TEST(test_rfind_char) {
+  for (ScanLevel level : supported_levels()) {
+    set_scan_level(level);
+    for (size_t length = 0; length < 200; ++length) {
+      string text = sample_text(length);
+      const char *first = text.data();
+      for (size_t end = 0; end <= length; end += 5) {
+        size_t expected = text.substr(0, end).rfind('\n');
+        const char *found = rfind_char(first, first + end, '\n');
+        ASSERT_EQUAL(found - first, expected == string::npos ? end
+                                                             : expected);
+      }
+    }
+  }
+  set_scan_level(max_scan_level());
+}
+
+TEST(test_count_char) {
+  // long enough to flush the per-byte vector counters several times
+  string text = sample_text(100000);
+  size_t expected = 0;
+  for (char c : text) {
+    expected += (c == '\n');
+  }
+  for (ScanLevel level : supported_levels()) {
+    set_scan_level(level);
+    ASSERT_EQUAL(count_char(text.data(), text.data() + text.size(), '\n'),
+                 expected);
+    for (size_t offset = 1; offset < 40; ++offset) {
+      string part = text.substr(offset, 1000 + offset);
+      size_t part_expected = 0;
+      for (char c : part) {
+        part_expected += (c == '\n');
+      }
+      ASSERT_EQUAL(count_char(part.data(), part.data() + part.size(), '\n'),
+                   part_expected);
+    }
+  }
+  set_scan_level(max_scan_level());
+}
+
+TEST(test_all_matches) {
+  string text(1000, 'x');
+  for (ScanLevel level : supported_levels()) {
+    set_scan_level(level);
+    const char *first = text.data(), *last = first + text.size();
+    ASSERT_EQUAL(count_char(first, last, 'x'), text.size());
+    ASSERT_EQUAL(count_char(first, last, 'y'), 0u);
+    ASSERT_EQUAL(find_char(first, last, 'x'), first);
+    ASSERT_EQUAL(rfind_char(first, last, 'x'), last - 1);
+    ASSERT_EQUAL(find_char(first, last, 'y'), last);
+    ASSERT_EQUAL(rfind_char(first, last, 'y'), last);
+  }
+  set_scan_level(max_scan_level());
+}
+
+TEST(test_find_pair) {
+  for (ScanLevel level : supported_levels()) {
+    set_scan_level(level);
+    for (size_t length = 0; length < 120; ++length) {
+      string text = sample_text(length);
+      const char *first = text.data(), *last = first + length;
+      for (ptrdiff_t distance = 0; distance < 40; distance += 3) {
+        size_t expected = length;
+        for (size_t i = 0; i + distance < length; ++i) {
+          if (text[i] == 'b' && text[i + distance] == 'e') {
+            expected = i;
+            break;
+          }
+        }
+        ASSERT_EQUAL(find_pair(first, last, 'b', 'e', distance) - first,
+                     expected);
+      }
+    }
+  }
+  set_scan_level(max_scan_level());
+}
+
+TEST(test_find_non_ascii) {
+  for (ScanLevel level : supported_levels()) {
+    set_scan_level(level);
+    for (size_t length = 1; length < 100; ++length) {
+      string text(length, 'a');
+      const char *first = text.data(), *last = first + length;
+      ASSERT_EQUAL(find_non_ascii(first, last), last);
+      text[length / 2] = '\xE9';
+      ASSERT_EQUAL(find_non_ascii(first, last) - first, length / 2);
+    }
+  }
+  set_scan_level(max_scan_level());
+}
+
+TEST(test_count_codepoints) {
+  // 1, 2, 3 and 4 byte sequences, repeated past several vector widths
+  const string unit = "a\xC3\xA9\xE4\xB8\xAD\xF0\x9F\x98\x80";
+  string text;
+  for (int i = 0; i < 1000; ++i) {
+    text += unit;
+  }
+  for (ScanLevel level : supported_levels()) {
+    set_scan_level(level);
+    const char *first = text.data();
+    ASSERT_EQUAL(count_codepoints(first, first + text.size()), 4000u);
+    ASSERT_EQUAL(count_codepoints(first, first + 3), 2u);
+    ASSERT_EQUAL(count_codepoints(first + 2, first + 5), 1u);
+    ASSERT_EQUAL(count_codepoints(first, first), 0u);
+  }
+  set_scan_level(max_scan_level());
+}
+
+TEST_MAIN()
@@ -0,0 +1,18 @@
+#ifndef CHARWIDTH_HPP
+#define CHARWIDTH_HPP
+/* CharWidth.hpp
+ *
+ * Onscreen widths of Unicode codepoints in a terminal, for placing the
+ * cursor and the rest of a row after non-ASCII characters.
+ *
+ * EECS 280 List/Editor Project
+ */
+
+//EFFECTS: Returns the onscreen width of a non-ASCII codepoint: 2 for East
+//         Asian wide and fullwidth characters, 0 for combining marks and
+//         zero-width characters, 1 otherwise. Returns -1 for codepoints
+//         below 0xA0 (ASCII, and the C1 control characters that must be
+//         escaped) and for values beyond Unicode.
+int codepoint_width(char32_t codepoint);
+
+#endif // CHARWIDTH_HPP
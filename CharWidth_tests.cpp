@@ -0,0 +1,55 @@
+#include "CharWidth.hpp"
+#include "unit_test_framework.hpp"
+
+TEST(test_escaped) {
+  ASSERT_EQUAL(codepoint_width('a'), -1);
+  ASSERT_EQUAL(codepoint_width(0x85), -1);
+  ASSERT_EQUAL(codepoint_width(0x110000), -1);
+  ASSERT_EQUAL(codepoint_width(0xFFFFFFFF), -1);
+}
+
+TEST(test_narrow) {
+  ASSERT_EQUAL(codepoint_width(0xA0), 1);
+  ASSERT_EQUAL(codepoint_width(0xE9), 1);     // e with acute
+  ASSERT_EQUAL(codepoint_width(0x2600), 1);   // sun, text presentation
+  ASSERT_EQUAL(codepoint_width(0x1F321), 1);  // thermometer
+  ASSERT_EQUAL(codepoint_width(0xFF61), 1);   // halfwidth ideographic stop
+  ASSERT_EQUAL(codepoint_width(0x10FFFF), 1);
+}
+
+TEST(test_zero_width) {
+  ASSERT_EQUAL(codepoint_width(0x0301), 0);   // combining acute
+  ASSERT_EQUAL(codepoint_width(0x200B), 0);   // zero width space
+  ASSERT_EQUAL(codepoint_width(0xFE0F), 0);   // variation selector 16
+}
+
+TEST(test_wide) {
+  ASSERT_EQUAL(codepoint_width(0x4E2D), 2);   // CJK ideograph
+  ASSERT_EQUAL(codepoint_width(0xAC00), 2);   // Hangul syllable
+  ASSERT_EQUAL(codepoint_width(0xFF21), 2);   // fullwidth A
+  ASSERT_EQUAL(codepoint_width(0x1F600), 2);  // grinning face
+  ASSERT_EQUAL(codepoint_width(0x3FFFD), 2);  // unassigned, wide by default
+}
+
+TEST(test_wide_emoji) {
+  ASSERT_EQUAL(codepoint_width(0x1F004), 2);  // mahjong red dragon
+  ASSERT_EQUAL(codepoint_width(0x1F0CF), 2);  // joker
+  ASSERT_EQUAL(codepoint_width(0x1F680), 2);  // rocket
+  ASSERT_EQUAL(codepoint_width(0x1F6FC), 2);  // roller skate
+  ASSERT_EQUAL(codepoint_width(0x1FA70), 2);  // ballet shoes
+  ASSERT_EQUAL(codepoint_width(0x1FAF6), 2);  // heart hands
+  ASSERT_EQUAL(codepoint_width(0x2648), 2);   // aries
+  ASSERT_EQUAL(codepoint_width(0x26A1), 2);   // high voltage
+  ASSERT_EQUAL(codepoint_width(0x2705), 2);   // check mark button
+  ASSERT_EQUAL(codepoint_width(0x274C), 2);   // cross mark
+  ASSERT_EQUAL(codepoint_width(0x27BF), 2);   // double curly loop
+}
+
+TEST(test_range_edges) {
+  ASSERT_EQUAL(codepoint_width(0x10FF), 1);
+  ASSERT_EQUAL(codepoint_width(0x1100), 2);
+  ASSERT_EQUAL(codepoint_width(0x115F), 2);
+  ASSERT_EQUAL(codepoint_width(0x1160), 1);
+}
+
+TEST_MAIN()
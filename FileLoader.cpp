@@ -0,0 +1,95 @@
+#include "FileLoader.hpp"
+#include "CharScan.hpp"
+
+FileLoader::FileLoader(const std::string &filename, std::size_t block_size_in)
+  : input(filename, std::ios::binary), opened(input.is_open()), size(0),
+    block_size(block_size_in), finished(false), canceled(false) {
+  if (!opened) {
+    finished = true;
+    return;
+  }
+  input.seekg(0, std::ios::end);
+  size = input.tellg();
+  input.seekg(0, std::ios::beg);
+  reader = std::thread(&FileLoader::read_blocks, this);
+}
+
+FileLoader::~FileLoader() {
+  cancel();
+  if (reader.joinable()) {
+    reader.join();
+  }
+}
+
+bool FileLoader::is_open() const {
+  return opened;
+}
+
+std::int64_t FileLoader::file_size() const {
+  return size;
+}
+
+bool FileLoader::take(std::string &block) {
+  std::unique_lock<std::mutex> lock(mutex);
+  changed.wait(lock, [this]() {
+    return !blocks.empty() || finished || canceled;
+  });
+  if (blocks.empty() || canceled) {
+    return false;
+  }
+  block = std::move(blocks.front());
+  blocks.pop_front();
+  changed.notify_all(); // there is room for another block
+  return true;
+}
+
+void FileLoader::cancel() {
+  std::lock_guard<std::mutex> lock(mutex);
+  canceled = true;
+  blocks.clear();
+  changed.notify_all();
+}
+
+std::size_t FileLoader::normalize_newlines(char *block, std::size_t count,
+                                           char &last) {
+  const char *end = block + count;
+  // nothing to convert before the first CR (common case: none at all)
+  char *out = (last == '\r' ? block
+               : const_cast<char *>(find_char(block, end, '\r')));
+  char previous = (out == block ? last : out[-1]);
+  for (const char *in = out; in != end; ++in) {
+    char c = *in;
+    if (previous != '\r' || c != '\n') {
+      *out++ = (c == '\r' ? '\n' : c);
+    }
+    previous = c;
+  }
+  last = previous;
+  return out - block;
+}
+
+void FileLoader::read_blocks() {
+  char last = '\0';
+  while (true) {
+    std::string block(block_size, '\0');
+    input.read(&block[0], block_size);
+    block.resize(normalize_newlines(&block[0], input.gcount(), last));
+
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]() {
+      return blocks.size() < MAX_QUEUED || canceled;
+    });
+    if (canceled) {
+      return;
+    }
+    if (!block.empty()) {
+      blocks.push_back(std::move(block));
+    }
+    if (!input) {
+      finished = true;
+      changed.notify_all();
+      return;
+    }
+    changed.notify_all();
+  }
+}
@@ -0,0 +1,86 @@
+#ifndef FILE_LOADER_HPP
+#define FILE_LOADER_HPP
+/* FileLoader.hpp
+ *
+ * Reads a file in large blocks on a worker thread, converting CR and
+ * CRLF line endings to LF in each block, while the editor inserts the
+ * blocks read so far into its buffer. Only a few blocks are read ahead,
+ * so memory use is bounded by the buffer rather than the file.
+ *
+ * EECS 280 List/Editor Project
+ */
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class FileLoader {
+public:
+  // Default number of bytes read at a time.
+  static const std::size_t BLOCK_SIZE = 1 << 20;
+
+  // Number of blocks that may be read ahead of the caller.
+  static const std::size_t MAX_QUEUED = 16;
+
+  //EFFECTS: Opens the file and, if that succeeds, starts reading it in
+  //         blocks of block_size bytes on a worker thread.
+  explicit FileLoader(const std::string &filename,
+                      std::size_t block_size = BLOCK_SIZE);
+
+  //EFFECTS: Cancels the reading and waits for the worker to stop.
+  ~FileLoader();
+
+  FileLoader(const FileLoader &) = delete;
+  FileLoader & operator=(const FileLoader &) = delete;
+
+  //EFFECTS: Returns whether the file could be opened.
+  bool is_open() const;
+
+  //EFFECTS: Returns the size of the file in bytes, or 0 if it could not
+  //         be opened.
+  std::int64_t file_size() const;
+
+  //MODIFIES: *this, block
+  //EFFECTS:  Waits for the next block of the file, with line endings
+  //          converted, and moves it into block. Returns false instead
+  //          once every block has been taken, or if reading failed or
+  //          was canceled.
+  bool take(std::string &block);
+
+  //MODIFIES: *this
+  //EFFECTS:  Stops reading. Blocks already read are discarded.
+  void cancel();
+
+  //MODIFIES: block, last
+  //EFFECTS:  Converts CR and CRLF to just LF in the first count bytes of
+  //          block, in place. last is the final byte of the previous
+  //          block (or '\0' for the first) and is updated to the final
+  //          byte of this one. Returns the new size of the block.
+  static std::size_t normalize_newlines(char *block, std::size_t count,
+                                        char &last);
+
+private:
+  std::ifstream input;
+  bool opened;
+  std::int64_t size;
+  std::size_t block_size;
+
+  // blocks read ahead by the worker, shared with it under mutex
+  std::thread reader;
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<std::string> blocks;
+  bool finished;  // the worker has queued its last block
+  bool canceled;
+
+  //MODIFIES: *this
+  //EFFECTS:  Reads the file into blocks until it ends or reading is
+  //          canceled. Runs on the worker thread.
+  void read_blocks();
+};
+
+#endif // FILE_LOADER_HPP
@@ -0,0 +1,100 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include "FileLoader.hpp"
+#include "unit_test_framework.hpp"
+
+using namespace std;
+
+static const char *FILENAME = "FileLoader_tests.tmp";
+
+// Writes contents to FILENAME.
+static void write_file(const string &contents) {
+  ofstream output(FILENAME, ios::binary);
+  output << contents;
+}
+
+// Returns everything loader reads.
+static string take_all(FileLoader &loader) {
+  string text;
+  string block;
+  while (loader.take(block)) {
+    text += block;
+  }
+  return text;
+}
+
+TEST(test_normalize_newlines) {
+  char last = '\0';
+  char first[] = "a\r\nb\rc\r";
+  ASSERT_EQUAL(FileLoader::normalize_newlines(first, 7, last), 6u);
+  ASSERT_EQUAL(string(first, 6), "a\nb\nc\n");
+  ASSERT_EQUAL(last, '\r');
+  // the LF of a CRLF split across blocks is dropped
+  char second[] = "\n\nd";
+  ASSERT_EQUAL(FileLoader::normalize_newlines(second, 3, last), 2u);
+  ASSERT_EQUAL(string(second, 2), "\nd");
+  ASSERT_EQUAL(last, 'd');
+  ASSERT_EQUAL(FileLoader::normalize_newlines(second, 0, last), 0u);
+  ASSERT_EQUAL(last, 'd');
+}
+
+TEST(test_reads_in_blocks) {
+  string contents;
+  string expected;
+  for (int i = 0; i < 1000; ++i) {
+    contents += "line " + to_string(i) + (i % 3 ? "\r\n" : "\r");
+    expected += "line " + to_string(i) + "\n";
+  }
+  write_file(contents);
+  // small blocks, so that many CRLFs are split between two of them and
+  // the worker has to wait for the queue to drain
+  for (size_t block_size : { 1, 2, 7, 64, 1 << 20 }) {
+    FileLoader loader(FILENAME, block_size);
+    ASSERT_TRUE(loader.is_open());
+    ASSERT_EQUAL(loader.file_size(),
+                 static_cast<int64_t>(contents.size()));
+    ASSERT_EQUAL(take_all(loader), expected);
+    string block;
+    ASSERT_FALSE(loader.take(block));
+  }
+  remove(FILENAME);
+}
+
+TEST(test_empty_file) {
+  write_file("");
+  FileLoader loader(FILENAME);
+  ASSERT_TRUE(loader.is_open());
+  ASSERT_EQUAL(loader.file_size(), 0);
+  ASSERT_EQUAL(take_all(loader), "");
+  remove(FILENAME);
+}
+
+TEST(test_missing_file) {
+  FileLoader loader("FileLoader_tests.missing");
+  ASSERT_FALSE(loader.is_open());
+  ASSERT_EQUAL(loader.file_size(), 0);
+  string block;
+  ASSERT_FALSE(loader.take(block));
+}
+
+TEST(test_cancel) {
+  write_file(string(100000, 'x'));
+  FileLoader loader(FILENAME, 16);
+  string block;
+  ASSERT_TRUE(loader.take(block));
+  ASSERT_EQUAL(block, string(16, 'x'));
+  loader.cancel();
+  ASSERT_FALSE(loader.take(block));
+  remove(FILENAME);
+}
+
+TEST(test_destroy_while_reading) {
+  write_file(string(100000, 'x'));
+  {
+    FileLoader loader(FILENAME, 16); // the worker is blocked on the queue
+  }
+  remove(FILENAME);
+}
+
+TEST_MAIN()
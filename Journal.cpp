@@ -0,0 +1,367 @@
+#include "Journal.hpp"
+#include "AtomicFile.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using Position = TextBuffer::Position;
+
+// Start of every journal, with the version of its format.
+static const std::string MAGIC = "femto journal 1\n";
+
+// Size of the header: the magic, the base and whether it exists, its
+// size and modification time, and a checksum.
+static const std::size_t HEADER_SIZE = MAGIC.size() + 2 + 3 * 8 + 4;
+
+// Size of a record without its inserted bytes: the index, the number
+// of bytes removed and inserted, and a checksum.
+static const std::size_t RECORD_SIZE = 3 * 8 + 4;
+
+// Appends value to bytes.
+static void put_int64(std::string &bytes, std::int64_t value) {
+  char buffer[8];
+  std::memcpy(buffer, &value, 8);
+  bytes.append(buffer, 8);
+}
+
+// Returns the value stored at bytes.
+static std::int64_t get_int64(const char *bytes) {
+  std::int64_t value;
+  std::memcpy(&value, bytes, 8);
+  return value;
+}
+
+// Appends the FNV-1a checksum of bytes to them.
+static void put_checksum(std::string &bytes, std::size_t start) {
+  std::uint32_t hash = 2166136261u;
+  for (std::size_t i = start; i < bytes.size(); ++i) {
+    hash = (hash ^ static_cast<unsigned char>(bytes[i])) * 16777619u;
+  }
+  bytes.append(reinterpret_cast<const char *>(&hash), 4);
+}
+
+// Returns whether the count bytes at bytes are followed by their
+// checksum.
+static bool has_checksum(const char *bytes, std::size_t count) {
+  std::string copy(bytes, count);
+  put_checksum(copy, 0);
+  return std::memcmp(copy.data() + count, bytes + count, 4) == 0;
+}
+
+Journal::Journal(TextBuffer &text_in, const std::string &filename_in,
+                 double sync_seconds_in)
+  : text(text_in), filename(filename_in), descriptor(-1), base(NONE),
+    written(0), snapshot_requested(false), compacting(false),
+    next_base(NONE),
+    sync_interval(std::chrono::duration_cast<clock::duration>(
+                    std::chrono::duration<double>(sync_seconds_in))),
+    unsynced(false) {
+  observer = text.subscribe([this](const TextBuffer::Edit &edit) {
+    record(edit);
+  });
+}
+
+Journal::~Journal() {
+  close_journal();
+  text.unsubscribe(observer);
+}
+
+std::string Journal::path_for(const std::string &filename) {
+  if (filename.empty()) {
+    return ".femto-journal";
+  }
+  std::size_t slash = filename.rfind('/');
+  // (slash + 1 is 0 if there is no slash)
+  return filename.substr(0, slash + 1) + "."
+    + filename.substr(slash + 1) + ".femto-journal";
+}
+
+bool Journal::is_recoverable(const std::string &filename,
+                             std::string &base) {
+  std::ifstream input(path_for(filename), std::ios::binary);
+  std::string header(HEADER_SIZE, '\0');
+  // a journal without edits has nothing to recover
+  if (!input.read(&header[0], HEADER_SIZE) || input.peek() == EOF
+      || header.compare(0, MAGIC.size(), MAGIC) != 0) {
+    return false;
+  }
+  Base which = static_cast<Base>(header[MAGIC.size()]);
+  if (which != ORIGINAL && which != SNAPSHOT_0 && which != SNAPSHOT_1) {
+    return false;
+  }
+  // the header identifies the base, which must not have changed
+  if (header != make_header(filename, which)) {
+    return false;
+  }
+  struct stat info;
+  base = base_path(filename, which);
+  if (stat(base.c_str(), &info) != 0) {
+    base.clear(); // a new file, which started out empty
+  }
+  return true;
+}
+
+void Journal::set_filename(const std::string &filename_in) {
+  close_journal();
+  base = NONE;
+  snapshot_requested = false;
+  compacting = false;
+  next_records.clear();
+  filename = filename_in;
+}
+
+bool Journal::start() {
+  Base old = base;
+  failure.clear();
+  snapshot_requested = false;
+  compacting = false;
+  next_records.clear();
+  if (!replace(make_header(filename, ORIGINAL), "", ORIGINAL)) {
+    return false;
+  }
+  if (old != ORIGINAL) {
+    std::remove(base_path(filename, SNAPSHOT_0).c_str());
+    std::remove(base_path(filename, SNAPSHOT_1).c_str());
+  }
+  return true;
+}
+
+void Journal::start_from_snapshot() {
+  set_filename(filename);
+  failure.clear();
+  snapshot_requested = true;
+}
+
+bool Journal::recover() {
+  std::ifstream input(path_for(filename), std::ios::binary);
+  std::string journal((std::istreambuf_iterator<char>(input)),
+                      std::istreambuf_iterator<char>());
+  Base which = (journal.size() < HEADER_SIZE ? NONE
+                : static_cast<Base>(journal[MAGIC.size()]));
+  if (which == NONE
+      || journal.compare(0, HEADER_SIZE, make_header(filename, which)) != 0) {
+    errno = EINVAL;
+    return fail("Cannot recover " + path_for(filename));
+  }
+
+  // apply each intact record; a crash may have cut off the last one
+  set_filename(filename);
+  std::size_t offset = HEADER_SIZE;
+  while (journal.size() - offset >= RECORD_SIZE) {
+    const char *record = journal.data() + offset;
+    Position index = get_int64(record);
+    Position removed = get_int64(record + 8);
+    Position count = get_int64(record + 16);
+    if (count < 0 || static_cast<std::size_t>(count)
+        > journal.size() - offset - RECORD_SIZE
+        || !has_checksum(record, RECORD_SIZE - 4 + count)
+        || index < 0 || removed < 0 || index + removed > text.size()) {
+      break;
+    }
+    text.move_to_index(index);
+    text.begin_batch();
+    text.erase(removed);
+    text.insert(record + 24, count);
+    text.end_batch();
+    offset += RECORD_SIZE + count;
+  }
+
+  // continue the journal after the last intact record
+  descriptor = open(path_for(filename).c_str(), O_WRONLY | O_APPEND);
+  if (descriptor == -1 || ftruncate(descriptor, offset) != 0) {
+    return fail("Cannot continue " + path_for(filename));
+  }
+  base = which;
+  written = offset;
+  return true;
+}
+
+void Journal::stop() {
+  set_filename(filename);
+  std::remove(path_for(filename).c_str());
+  std::remove(base_path(filename, SNAPSHOT_0).c_str());
+  std::remove(base_path(filename, SNAPSHOT_1).c_str());
+}
+
+bool Journal::is_recording() const {
+  return base != NONE || compacting;
+}
+
+std::int64_t Journal::size() const {
+  return written;
+}
+
+int Journal::milliseconds_until_sync() const {
+  if (!unsynced) {
+    return -1;
+  }
+  auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+    first_unsynced + sync_interval - clock::now()).count();
+  return std::max<int>(0, remaining);
+}
+
+void Journal::poll() {
+  if (unsynced && milliseconds_until_sync() == 0) {
+    unsynced = false;
+    if (fdatasync(descriptor) != 0) {
+      fail("Cannot sync " + path_for(filename));
+    }
+  }
+}
+
+bool Journal::needs_compaction() const {
+  return !compacting
+    && (snapshot_requested
+        || (base != NONE && written > std::max<std::int64_t>(COMPACT_SIZE,
+                                                              text.size())));
+}
+
+std::string Journal::snapshot_path() const {
+  return base_path(filename, base == SNAPSHOT_0 ? SNAPSHOT_1 : SNAPSHOT_0);
+}
+
+void Journal::begin_compaction() {
+  compacting = true;
+  next_base = (base == SNAPSHOT_0 ? SNAPSHOT_1 : SNAPSHOT_0);
+  next_records.clear();
+}
+
+bool Journal::finish_compaction(bool written_in) {
+  if (!compacting) {
+    return false;
+  }
+  compacting = false;
+  std::string records;
+  records.swap(next_records);
+  if (!written_in) {
+    return false;
+  }
+  Base old = base;
+  if (!replace(make_header(filename, next_base), records, next_base)) {
+    return false;
+  }
+  snapshot_requested = false;
+  if (old == SNAPSHOT_0 || old == SNAPSHOT_1) {
+    std::remove(base_path(filename, old).c_str());
+  }
+  return true;
+}
+
+const std::string & Journal::error() const {
+  return failure;
+}
+
+std::string Journal::base_path(const std::string &filename, Base which) {
+  std::string snapshot = path_for(filename);
+  snapshot.replace(snapshot.size() - 7, 7, "base"); // "journal"
+  switch (which) {
+  case ORIGINAL:
+    return filename;
+  case SNAPSHOT_0:
+    return snapshot + "0";
+  default:
+    return snapshot + "1";
+  }
+}
+
+std::string Journal::make_header(const std::string &filename, Base which) {
+  std::string header = MAGIC;
+  header += which;
+  struct stat info;
+  std::string path = base_path(filename, which);
+  bool exists = !path.empty() && stat(path.c_str(), &info) == 0;
+  header += static_cast<char>(exists);
+  put_int64(header, exists ? info.st_size : 0);
+  put_int64(header, exists ? info.st_mtim.tv_sec : 0);
+  put_int64(header, exists ? info.st_mtim.tv_nsec : 0);
+  put_checksum(header, 0);
+  return header;
+}
+
+void Journal::record(const TextBuffer::Edit &edit) {
+  if (!is_recording()) {
+    return;
+  }
+  std::string bytes;
+  bytes.reserve(RECORD_SIZE + edit.inserted.size());
+  put_int64(bytes, edit.index);
+  put_int64(bytes, edit.removed);
+  put_int64(bytes, edit.inserted.size());
+  bytes += edit.inserted;
+  put_checksum(bytes, 0);
+  if (compacting) {
+    next_records += bytes;
+  }
+  if (base != NONE) {
+    append(bytes);
+  }
+}
+
+bool Journal::replace(const std::string &header, const std::string &records,
+                      Base which) {
+  close_journal();
+  base = NONE;
+  std::string path = path_for(filename);
+  AtomicFile file(path);
+  file.write(header.data(), header.size());
+  file.write(records.data(), records.size());
+  if (!file.commit(true)) {
+    failure = file.error();
+    return false;
+  }
+  descriptor = open(path.c_str(), O_WRONLY | O_APPEND);
+  if (descriptor == -1) {
+    return fail("Cannot open " + path);
+  }
+  base = which;
+  written = header.size() + records.size();
+  return true;
+}
+
+bool Journal::append(const std::string &bytes) {
+  const char *data = bytes.data();
+  std::size_t count = bytes.size();
+  while (count > 0) {
+    ssize_t result = ::write(descriptor, data, count);
+    if (result == -1 && errno != EINTR) {
+      return fail("Cannot write " + path_for(filename));
+    } else if (result > 0) {
+      data += result;
+      count -= result;
+    }
+  }
+  written += bytes.size();
+  if (!unsynced) {
+    unsynced = true;
+    first_unsynced = clock::now();
+  }
+  return true;
+}
+
+bool Journal::fail(const std::string &what) {
+  if (failure.empty()) {
+    failure = what + ": " + std::strerror(errno);
+  }
+  close_journal();
+  base = NONE;
+  compacting = false;
+  next_records.clear();
+  return false;
+}
+
+void Journal::close_journal() {
+  if (descriptor != -1) {
+    if (unsynced) {
+      fdatasync(descriptor);
+    }
+    close(descriptor);
+    descriptor = -1;
+  }
+  unsynced = false;
+}
@@ -0,0 +1,201 @@
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+/* Journal.hpp
+ *
+ * An append-only journal of the edits made to a TextBuffer, kept in a
+ * hidden file next to the file being edited, from which the edits can
+ * be recovered if the editor does not exit normally. Each edit is
+ * appended as it is made, so it survives the editor crashing, and the
+ * journal is synced to disk in groups of edits, at most once every
+ * sync interval, so that it also survives a power failure without a
+ * sync per key.
+ *
+ * The edits apply to a base: the file as it was when the journal was
+ * started, or a snapshot of the text. Once the journal grows past the
+ * size of the text, it is compacted: a snapshot is written, and the
+ * journal is replaced by one of the edits made since, which apply to
+ * the snapshot. Snapshots alternate between two files, and the new
+ * journal is renamed over the old one, so that at any moment either the
+ * old or the new journal is intact along with its base.
+ *
+ * EECS 280 List/Editor Project
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include "TextBuffer.hpp"
+
+class Journal {
+public:
+  using clock = std::chrono::steady_clock;
+
+  // Smallest size in bytes at which the journal is compacted.
+  static constexpr std::int64_t COMPACT_SIZE = 16 << 20;
+
+  // Default longest time in seconds that an edit goes unsynced.
+  static constexpr double SYNC_SECONDS = 1;
+
+  //MODIFIES: text
+  //EFFECTS:  Creates a journal, which is not recording yet, of edits to
+  //          text that is loaded from filename (which may be empty), and
+  //          observes the text. The text must outlive the journal.
+  Journal(TextBuffer &text_in, const std::string &filename,
+          double sync_seconds_in = SYNC_SECONDS);
+
+  //MODIFIES: text, the file system
+  //EFFECTS:  Syncs the journal and stops observing the text. The journal
+  //          file is kept.
+  ~Journal();
+
+  Journal(const Journal &) = delete;
+  Journal & operator=(const Journal &) = delete;
+
+  //EFFECTS: Returns the name of the journal file for filename: a hidden
+  //         file in the same directory, or .femto-journal in the current
+  //         directory if filename is empty.
+  static std::string path_for(const std::string &filename);
+
+  //EFFECTS: Returns whether there is a journal for filename whose base
+  //         has not changed since, and if so sets base to the name of
+  //         the base, which is empty if it is an empty text.
+  static bool is_recoverable(const std::string &filename, std::string &base);
+
+  //MODIFIES: *this
+  //EFFECTS:  Journals the edits to the text loaded from filename from
+  //          now on. Recording stops until start() is called again.
+  void set_filename(const std::string &filename);
+
+  //MODIFIES: *this, the file system
+  //EFFECTS:  Starts a new journal, replacing any journal for the file,
+  //          of the edits made from now on to the text, which must hold
+  //          the contents of the file. Returns whether it was created.
+  bool start();
+
+  //MODIFIES: *this
+  //EFFECTS:  Requests that recording start from a snapshot of the text,
+  //          for a text that may differ from the file. Edits are
+  //          recorded from the start of the compaction that writes it.
+  void start_from_snapshot();
+
+  //REQUIRES: is_recoverable(filename, base), and text holds base
+  //MODIFIES: *this, text, the file system
+  //EFFECTS:  Applies the edits in the journal to the text, and records
+  //          the edits made from now on after them. Returns whether the
+  //          journal could be read and continued; any edits after a
+  //          damaged record are dropped.
+  bool recover();
+
+  //MODIFIES: *this, the file system
+  //EFFECTS:  Stops recording, and removes the journal and its snapshots.
+  void stop();
+
+  //EFFECTS: Returns whether edits are being recorded.
+  bool is_recording() const;
+
+  //EFFECTS: Returns the size of the journal in bytes.
+  std::int64_t size() const;
+
+  //EFFECTS: Returns the number of milliseconds until the journal must
+  //         be synced, or -1 if all edits have been synced.
+  int milliseconds_until_sync() const;
+
+  //MODIFIES: *this, the file system
+  //EFFECTS:  Syncs the journal if the sync interval has passed since the
+  //          oldest edit that is not synced.
+  void poll();
+
+  //EFFECTS: Returns whether the journal should be compacted, either
+  //         because it is larger than the text (and COMPACT_SIZE), or
+  //         because recording is to start from a snapshot.
+  bool needs_compaction() const;
+
+  //EFFECTS: Returns the file to write the snapshot for the next
+  //         compaction to.
+  std::string snapshot_path() const;
+
+  //MODIFIES: *this
+  //EFFECTS:  Marks the point at which a snapshot of the text is taken
+  //          for a compaction. The edits made from now on go into the
+  //          new journal as well as the current one, if any.
+  void begin_compaction();
+
+  //MODIFIES: *this, the file system
+  //EFFECTS:  Replaces the journal with the new one, whose base is the
+  //          snapshot at snapshot_path(), now written, and removes the
+  //          old snapshot. If written is false, the snapshot could not
+  //          be written, and the current journal is kept instead.
+  //          Returns whether the journal was replaced.
+  bool finish_compaction(bool written);
+
+  //EFFECTS: Returns a description of the first failure, or an empty
+  //         string if there has been none. Recording stops on failure.
+  const std::string & error() const;
+
+private:
+  // What the edits in a journal apply to.
+  enum Base : char {
+    ORIGINAL,    // the file being edited
+    SNAPSHOT_0,  // the first snapshot file
+    SNAPSHOT_1,  // the second snapshot file
+    NONE         // not recording
+  };
+
+  TextBuffer &text;
+  int observer;
+  std::string filename;
+  int descriptor;
+  Base base;
+  std::int64_t written;
+
+  // the new journal during a compaction, and its base
+  bool snapshot_requested;
+  bool compacting;
+  Base next_base;
+  std::string next_records;
+
+  // whether there are edits that are not synced, and when the oldest
+  // of them was made
+  const clock::duration sync_interval;
+  bool unsynced;
+  clock::time_point first_unsynced;
+
+  std::string failure;
+
+  //EFFECTS: Returns the name of the file that holds the given base of
+  //         the journal for filename.
+  static std::string base_path(const std::string &filename, Base which);
+
+  //EFFECTS: Returns the header of a journal whose edits apply to the
+  //         given base, which identifies the base as it is now.
+  static std::string make_header(const std::string &filename, Base which);
+
+  //MODIFIES: *this
+  //EFFECTS:  Appends a record of edit to the journal and, during a
+  //          compaction, to the new journal.
+  void record(const TextBuffer::Edit &edit);
+
+  //MODIFIES: *this, the file system
+  //EFFECTS:  Writes the journal made of header and records to a
+  //          temporary file, syncs it and renames it over the journal,
+  //          then keeps it open to append to. Returns whether it
+  //          succeeded.
+  bool replace(const std::string &header, const std::string &records,
+               Base which);
+
+  //MODIFIES: *this
+  //EFFECTS:  Appends bytes to the journal. Returns whether they were
+  //          written.
+  bool append(const std::string &bytes);
+
+  //MODIFIES: *this
+  //EFFECTS:  Records what failed, with the system's reason, stops
+  //          recording and returns false.
+  bool fail(const std::string &what);
+
+  //MODIFIES: *this
+  //EFFECTS:  Closes the journal file, if it is open.
+  void close_journal();
+};
+
+#endif // JOURNAL_HPP
@@ -0,0 +1,246 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include "AtomicFile.hpp"
+#include "Journal.hpp"
+#include "unit_test_framework.hpp"
+
+using namespace std;
+
+static const char *FILENAME = "Journal_tests.tmp";
+
+// Returns the contents of filename.
+static string read_file(const string &filename) {
+  ifstream input(filename, ios::binary);
+  ostringstream contents;
+  contents << input.rdbuf();
+  return contents.str();
+}
+
+// Returns whether filename exists.
+static bool exists(const string &filename) {
+  return ifstream(filename).good();
+}
+
+// Returns the contents of text.
+static string contents(const TextBuffer &text) {
+  string result;
+  text.visit(0, text.size(), [&](const char *block,
+                                 TextBuffer::Position count) {
+    result.append(block, count);
+    return true;
+  });
+  return result;
+}
+
+// Recovers the journal for FILENAME into a new buffer holding its base,
+// and returns the text.
+static string recover() {
+  string base;
+  ASSERT_TRUE(Journal::is_recoverable(FILENAME, base));
+  TextBuffer text;
+  string original = read_file(base);
+  text.insert(original.data(), original.size());
+  Journal journal(text, FILENAME);
+  ASSERT_TRUE(journal.recover());
+  ASSERT_EQUAL(journal.error(), "");
+  string result = contents(text);
+  journal.stop();
+  return result;
+}
+
+// Creates FILENAME with the given contents, and removes any journal.
+static void reset(const string &original) {
+  TextBuffer text;
+  Journal(text, FILENAME).stop();
+  ofstream(FILENAME) << original;
+}
+
+TEST(test_path_for) {
+  ASSERT_EQUAL(Journal::path_for("a.txt"), ".a.txt.femto-journal");
+  ASSERT_EQUAL(Journal::path_for("dir/a.txt"), "dir/.a.txt.femto-journal");
+  ASSERT_EQUAL(Journal::path_for(""), ".femto-journal");
+}
+
+TEST(test_recovers_edits) {
+  reset("hello world");
+  string base;
+  ASSERT_FALSE(Journal::is_recoverable(FILENAME, base));
+  {
+    TextBuffer text;
+    text.insert("hello world", 11);
+    Journal journal(text, FILENAME);
+    ASSERT_TRUE(journal.start());
+    ASSERT_TRUE(journal.is_recording());
+    ASSERT_FALSE(Journal::is_recoverable(FILENAME, base)); // no edits
+    text.move_to_index(5);
+    text.insert(",", 1);
+    text.move_to_index(7);
+    text.erase(5);
+    text.insert("there", 5);
+    text.move_to_index(0);
+    text.begin_batch();
+    text.erase(1);
+    text.insert('H');
+    text.end_batch();
+  } // the journal is kept, as if the editor had crashed
+  ASSERT_TRUE(Journal::is_recoverable(FILENAME, base));
+  ASSERT_EQUAL(base, FILENAME);
+  ASSERT_EQUAL(recover(), "Hello, there");
+  ASSERT_FALSE(exists(Journal::path_for(FILENAME)));
+  remove(FILENAME);
+}
+
+TEST(test_drops_torn_record) {
+  reset("abc");
+  {
+    TextBuffer text;
+    text.insert("abc", 3);
+    Journal journal(text, FILENAME);
+    journal.start();
+    text.insert("1", 1);
+    text.insert("2345", 4);
+  }
+  // cut off the end of the last record, as a crash might
+  string path = Journal::path_for(FILENAME);
+  ASSERT_EQUAL(truncate(path.c_str(), read_file(path).size() - 2), 0);
+  ASSERT_EQUAL(recover(), "abc1");
+  remove(FILENAME);
+}
+
+TEST(test_recovery_continues_journal) {
+  reset("");
+  {
+    TextBuffer text;
+    Journal journal(text, FILENAME);
+    journal.start();
+    text.insert("one", 3);
+  }
+  {
+    string base;
+    ASSERT_TRUE(Journal::is_recoverable(FILENAME, base));
+    TextBuffer text; // the base is empty
+    Journal journal(text, FILENAME);
+    ASSERT_TRUE(journal.recover());
+    text.insert(" two", 4);
+  }
+  ASSERT_EQUAL(recover(), "one two");
+  remove(FILENAME);
+}
+
+TEST(test_changed_base_is_not_recoverable) {
+  reset("saved");
+  {
+    TextBuffer text;
+    text.insert("saved", 5);
+    Journal journal(text, FILENAME);
+    journal.start();
+    text.insert("!", 1);
+  }
+  string base;
+  ASSERT_TRUE(Journal::is_recoverable(FILENAME, base));
+  this_thread::sleep_for(chrono::milliseconds(10));
+  ofstream(FILENAME) << "saved again";
+  ASSERT_FALSE(Journal::is_recoverable(FILENAME, base));
+  reset("");
+  remove(FILENAME);
+}
+
+TEST(test_compaction) {
+  reset("base");
+  string old_snapshot;
+  {
+    TextBuffer text;
+    text.insert("base", 4);
+    Journal journal(text, FILENAME);
+    journal.start();
+    text.insert(" one", 4);
+    ASSERT_FALSE(journal.needs_compaction());
+
+    // two compactions, so that the snapshots alternate
+    for (int i = 0; i < 2; ++i) {
+      string snapshot = journal.snapshot_path();
+      ASSERT_NOT_EQUAL(snapshot, old_snapshot);
+      journal.begin_compaction();
+      ASSERT_FALSE(journal.needs_compaction());
+      string error;
+      ASSERT_TRUE(save_text(text, snapshot, false, error));
+      text.insert(i == 0 ? " two" : " three", i == 0 ? 4 : 6);
+      ASSERT_TRUE(journal.finish_compaction(true));
+      ASSERT_TRUE(exists(snapshot));
+      ASSERT_FALSE(exists(old_snapshot));
+      old_snapshot = snapshot;
+    }
+    text.insert(" four", 5);
+  }
+  string base;
+  ASSERT_TRUE(Journal::is_recoverable(FILENAME, base));
+  ASSERT_EQUAL(base, old_snapshot);
+  ASSERT_EQUAL(read_file(base), "base one two");
+  ASSERT_EQUAL(recover(), "base one two three four");
+  ASSERT_FALSE(exists(old_snapshot));
+  remove(FILENAME);
+}
+
+TEST(test_failed_compaction_keeps_journal) {
+  reset("base");
+  {
+    TextBuffer text;
+    text.insert("base", 4);
+    Journal journal(text, FILENAME);
+    journal.start();
+    journal.begin_compaction();
+    text.insert("!", 1);
+    ASSERT_FALSE(journal.finish_compaction(false));
+    ASSERT_TRUE(journal.is_recording());
+    text.insert("?", 1);
+  }
+  ASSERT_EQUAL(recover(), "base!?");
+  remove(FILENAME);
+}
+
+TEST(test_start_from_snapshot) {
+  reset("file");
+  TextBuffer text;
+  text.insert("edited", 6);
+  Journal journal(text, FILENAME);
+  journal.start_from_snapshot();
+  ASSERT_FALSE(journal.is_recording());
+  ASSERT_TRUE(journal.needs_compaction());
+  journal.begin_compaction();
+  ASSERT_TRUE(journal.is_recording());
+  string error;
+  ASSERT_TRUE(save_text(text, journal.snapshot_path(), false, error));
+  text.insert(" more", 5);
+  ASSERT_TRUE(journal.finish_compaction(true));
+  ASSERT_FALSE(journal.needs_compaction());
+  ASSERT_EQUAL(recover(), "edited more");
+  remove(FILENAME);
+}
+
+TEST(test_sync_interval) {
+  reset("");
+  TextBuffer text;
+  Journal journal(text, FILENAME, 0.05);
+  journal.start();
+  ASSERT_EQUAL(journal.milliseconds_until_sync(), -1);
+  text.insert('x');
+  int wait = journal.milliseconds_until_sync();
+  ASSERT_TRUE(wait > 0 && wait <= 50);
+  journal.poll(); // not due yet
+  ASSERT_NOT_EQUAL(journal.milliseconds_until_sync(), -1);
+  this_thread::sleep_for(chrono::milliseconds(60));
+  ASSERT_EQUAL(journal.milliseconds_until_sync(), 0);
+  journal.poll();
+  ASSERT_EQUAL(journal.milliseconds_until_sync(), -1);
+  journal.stop();
+  ASSERT_FALSE(journal.is_recording());
+  ASSERT_FALSE(exists(Journal::path_for(FILENAME)));
+  remove(FILENAME);
+}
+
+TEST_MAIN()
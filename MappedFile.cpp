@@ -0,0 +1,83 @@
+#include "MappedFile.hpp"
+#include "FileLoader.hpp"
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &filename)
+  : data(nullptr), length(0), mapped(false), taken(0), last_taken('\0') {
+  int descriptor = open(filename.c_str(), O_RDONLY);
+  if (descriptor == -1) {
+    return;
+  }
+  struct stat info;
+  if (fstat(descriptor, &info) == 0 && S_ISREG(info.st_mode)) {
+    length = info.st_size;
+    if (length == 0) {
+      mapped = true; // nothing to map
+    } else {
+      void *address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE,
+                           descriptor, 0);
+      mapped = (address != MAP_FAILED);
+      data = mapped ? static_cast<const char *>(address) : nullptr;
+    }
+  }
+  if (!mapped) {
+    length = 0;
+  }
+  close(descriptor); // the mapping keeps the file open
+}
+
+MappedFile::~MappedFile() {
+  if (data) {
+    munmap(const_cast<char *>(data), length);
+  }
+}
+
+bool MappedFile::is_open() const {
+  return mapped;
+}
+
+std::int64_t MappedFile::size() const {
+  return length;
+}
+
+std::int64_t MappedFile::offset() const {
+  return taken;
+}
+
+bool MappedFile::take(std::string &block, std::size_t block_size) {
+  if (taken == length) {
+    return false;
+  }
+  std::size_t count = std::min<std::int64_t>(block_size, length - taken);
+  block.assign(data + taken, count);
+  block.resize(FileLoader::normalize_newlines(&block[0], count, last_taken));
+  release(taken, taken + count);
+  taken += count;
+  return true;
+}
+
+std::int64_t MappedFile::find_after(const Searcher &searcher) const {
+  std::int64_t size = searcher.pattern().size();
+  if (size == 0 || size > length) {
+    return -1;
+  }
+  // an occurrence may start in the last bytes taken
+  std::int64_t start = std::max<std::int64_t>(0, taken - size + 1);
+  const char *end = data + length;
+  const char *match = searcher.find(data + start, end);
+  release(start, match == end ? length : match - data);
+  return match == end ? -1 : match - data + size;
+}
+
+void MappedFile::release(std::int64_t first, std::int64_t last) const {
+  std::int64_t page = sysconf(_SC_PAGESIZE);
+  first = first / page * page;
+  last = last / page * page;
+  if (first < last) {
+    madvise(const_cast<char *>(data) + first, last - first, MADV_DONTNEED);
+  }
+}
@@ -0,0 +1,73 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+/* MappedFile.hpp
+ *
+ * A file mapped read-only into memory and taken into the editor's buffer
+ * in blocks only as far as it is needed, so that a huge file can be
+ * opened without reading all of it. Only the pages of the file that are
+ * taken or searched are read by the operating system, and they are
+ * released again afterwards, so resident memory stays proportional to
+ * what has been taken rather than to the size of the file. As with any
+ * mapping, the file must not be truncated by another program meanwhile.
+ *
+ * EECS 280 List/Editor Project
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "Search.hpp"
+
+class MappedFile {
+public:
+  // Default number of bytes taken at a time.
+  static const std::size_t BLOCK_SIZE = 1 << 20;
+
+  //EFFECTS: Maps the file read-only. The mapping fails if the file
+  //         cannot be opened or is not a regular file.
+  explicit MappedFile(const std::string &filename);
+
+  //EFFECTS: Unmaps the file.
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile & operator=(const MappedFile &) = delete;
+
+  //EFFECTS: Returns whether the file was mapped.
+  bool is_open() const;
+
+  //EFFECTS: Returns the size of the file in bytes, or 0 if it was not
+  //         mapped.
+  std::int64_t size() const;
+
+  //EFFECTS: Returns the number of bytes of the file taken so far.
+  std::int64_t offset() const;
+
+  //MODIFIES: *this, block
+  //EFFECTS:  Copies the next block_size bytes of the file (or the rest
+  //          of it), with CR and CRLF converted to LF, into block, and
+  //          releases the pages they were read from. Returns false
+  //          instead if the whole file has been taken.
+  bool take(std::string &block, std::size_t block_size = BLOCK_SIZE);
+
+  //EFFECTS: Returns the offset just past the first occurrence of the
+  //         searcher's pattern in the file that ends after the bytes
+  //         taken so far, or -1 if there is none. The pattern is matched
+  //         against the bytes as they are in the file, before newlines
+  //         are converted.
+  std::int64_t find_after(const Searcher &searcher) const;
+
+private:
+  const char *data;
+  std::int64_t length;
+  bool mapped;
+  std::int64_t taken;
+  char last_taken; // for converting a CRLF split between two blocks
+
+  //EFFECTS: Lets the operating system drop the pages of the file from the
+  //         one that holds first up to, but not including, the one that
+  //         holds last.
+  void release(std::int64_t first, std::int64_t last) const;
+};
+
+#endif // MAPPED_FILE_HPP
@@ -0,0 +1,82 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include "MappedFile.hpp"
+#include "unit_test_framework.hpp"
+
+using namespace std;
+
+static const char *FILENAME = "MappedFile_tests.tmp";
+
+// Writes contents to FILENAME.
+static void write_file(const string &contents) {
+  ofstream output(FILENAME, ios::binary);
+  output << contents;
+}
+
+TEST(test_take_in_blocks) {
+  string contents;
+  string expected;
+  for (int i = 0; i < 1000; ++i) {
+    contents += "line " + to_string(i) + (i % 3 ? "\r\n" : "\r");
+    expected += "line " + to_string(i) + "\n";
+  }
+  write_file(contents);
+  for (size_t block_size : { 1, 2, 7, 4096, 1 << 20 }) {
+    MappedFile file(FILENAME);
+    ASSERT_TRUE(file.is_open());
+    ASSERT_EQUAL(file.size(), static_cast<int64_t>(contents.size()));
+    string text;
+    string block;
+    int64_t offset = 0;
+    while (file.take(block, block_size)) {
+      text += block;
+      offset = min<int64_t>(file.size(), offset + block_size);
+      ASSERT_EQUAL(file.offset(), offset);
+    }
+    ASSERT_EQUAL(text, expected);
+    ASSERT_EQUAL(file.offset(), file.size());
+  }
+  remove(FILENAME);
+}
+
+TEST(test_find_after) {
+  string contents = "abc needle def\nneedle\nxyz";
+  write_file(contents);
+  MappedFile file(FILENAME);
+  Searcher needle("needle");
+  ASSERT_EQUAL(file.find_after(needle), 10);
+  string block;
+  file.take(block, 6); // "abc ne": the occurrence ends after it
+  ASSERT_EQUAL(file.find_after(needle), 10);
+  file.take(block, 4); // "edle"
+  ASSERT_EQUAL(file.find_after(needle), 21);
+  file.take(block, 20);
+  ASSERT_EQUAL(file.find_after(needle), -1);
+  ASSERT_EQUAL(file.find_after(Searcher("")), -1);
+  ASSERT_EQUAL(file.find_after(Searcher(contents + "!")), -1);
+  remove(FILENAME);
+}
+
+TEST(test_empty_file) {
+  write_file("");
+  MappedFile file(FILENAME);
+  ASSERT_TRUE(file.is_open());
+  ASSERT_EQUAL(file.size(), 0);
+  string block;
+  ASSERT_FALSE(file.take(block));
+  ASSERT_EQUAL(file.find_after(Searcher("a")), -1);
+  remove(FILENAME);
+}
+
+TEST(test_not_mapped) {
+  MappedFile missing("MappedFile_tests.missing");
+  ASSERT_FALSE(missing.is_open());
+  ASSERT_EQUAL(missing.size(), 0);
+  string block;
+  ASSERT_FALSE(missing.take(block));
+  MappedFile directory(".");
+  ASSERT_FALSE(directory.is_open());
+}
+
+TEST_MAIN()
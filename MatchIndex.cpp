@@ -0,0 +1,202 @@
+#include "MatchIndex.hpp"
+#include "Search.hpp"
+#include <algorithm>
+#include <cassert>
+
+using Position = MatchIndex::Position;
+
+MatchIndex::MatchIndex(TextBuffer &text_in)
+  : text(text_in), is_ready(false), is_copying(false), copy_index(0),
+    cancel(false), done(false) {
+  observer = text.subscribe([this](const TextBuffer::Edit &edit) {
+    handle_edit(edit);
+  });
+}
+
+MatchIndex::~MatchIndex() {
+  stop();
+  text.unsubscribe(observer);
+}
+
+void MatchIndex::start(const std::string &pattern_in) {
+  clear();
+  needle = pattern_in;
+  if (needle.empty()) {
+    return;
+  }
+  // the worker searches a copy, since the text may change meanwhile
+  is_copying = true;
+  copy_index = 0;
+  snapshot.reserve(text.size());
+}
+
+void MatchIndex::clear() {
+  stop();
+  needle.clear();
+  matches.clear();
+  is_ready = false;
+  pending_edits.clear();
+  dirty.clear();
+}
+
+bool MatchIndex::poll() {
+  if (is_copying) {
+    Position last = std::min(text.size(), copy_index + COPY_SIZE);
+    text.visit(copy_index, last, [&](const char *block, Position count) {
+      snapshot.append(block, count);
+      return true;
+    });
+    copy_index = last;
+    if (copy_index == text.size()) {
+      is_copying = false;
+      worker = std::thread(&MatchIndex::find_all, this, needle,
+                           std::move(snapshot));
+      snapshot.clear();
+    }
+  } else if (worker.joinable() && done) {
+    worker.join();
+    matches = std::move(found);
+    found.clear();
+    for (const TextBuffer::Edit &edit : pending_edits) {
+      shift_matches(edit);
+    }
+    pending_edits.clear();
+    rescan();
+    is_ready = true;
+  }
+  return is_ready;
+}
+
+bool MatchIndex::copying() const {
+  return is_copying;
+}
+
+bool MatchIndex::pending() const {
+  return is_copying || worker.joinable();
+}
+
+bool MatchIndex::ready() const {
+  return is_ready;
+}
+
+const std::string & MatchIndex::pattern() const {
+  return needle;
+}
+
+const std::vector<Position> & MatchIndex::positions() const {
+  assert(is_ready);
+  return matches;
+}
+
+void MatchIndex::find_all(const std::string &pattern,
+                          const std::string &snapshot) {
+  Searcher searcher(pattern);
+  const char *first = snapshot.data();
+  const Position total = snapshot.size();
+  const Position size = pattern.size();
+  for (Position chunk = 0; chunk < total && !cancel; chunk += CHUNK_SIZE) {
+    // occurrences that start in the chunk may end after it
+    Position chunk_end = std::min(total, chunk + CHUNK_SIZE);
+    const char *window_end = first + std::min(total, chunk_end + size - 1);
+    for (const char *match = searcher.find(first + chunk, window_end);
+         match != window_end; match = searcher.find(match + 1, window_end)) {
+      found.push_back(match - first);
+    }
+  }
+  done = true;
+}
+
+void MatchIndex::stop() {
+  if (worker.joinable()) {
+    cancel = true;
+    worker.join();
+  }
+  cancel = false;
+  done = false;
+  found.clear();
+  is_copying = false;
+  snapshot.clear();
+}
+
+void MatchIndex::handle_edit(const TextBuffer::Edit &edit) {
+  if (needle.empty()) {
+    return;
+  }
+  Position end = edit.index + edit.removed;
+  Position delta = edit.inserted.size() - edit.removed;
+  for (Range &range : dirty) {
+    for (Position *bound : { &range.first, &range.second }) {
+      if (*bound >= end) {
+        *bound += delta;
+      } else if (*bound > edit.index) {
+        *bound = edit.index;
+      }
+    }
+  }
+  // occurrences may now start anywhere from a pattern's length before
+  // the edit to the end of the inserted bytes
+  Position size = needle.size();
+  dirty.push_back({ edit.index - size + 1,
+                    edit.index + static_cast<Position>(edit.inserted.size()) });
+  if (is_ready) {
+    shift_matches(edit);
+    rescan();
+  } else if (!is_copying) {
+    pending_edits.push_back(edit);
+  } else {
+    if (edit.index < copy_index && end > copy_index) {
+      // the rest of the snapshot is copied from the start of the edit
+      snapshot.resize(snapshot.size() - (copy_index - edit.index));
+      copy_index = edit.index;
+    }
+    if (edit.index < copy_index) {
+      pending_edits.push_back(edit);
+      copy_index += delta;
+    }
+  }
+}
+
+void MatchIndex::shift_matches(const TextBuffer::Edit &edit) {
+  Position size = needle.size();
+  auto first = std::lower_bound(matches.begin(), matches.end(),
+                                edit.index - size + 1);
+  auto last = std::lower_bound(first, matches.end(),
+                               edit.index + edit.removed);
+  auto moved = matches.erase(first, last);
+  Position delta = edit.inserted.size() - edit.removed;
+  for (auto it = moved; it != matches.end(); ++it) {
+    *it += delta;
+  }
+}
+
+void MatchIndex::rescan() {
+  Searcher searcher(needle);
+  const Position size = needle.size();
+  std::string window;
+  for (const Range &range : dirty) {
+    Position first = std::max<Position>(0, range.first);
+    Position last = std::min(text.size(), range.second);
+    if (first >= last) {
+      continue;
+    }
+    // copy the range once, with the bytes that occurrences starting in
+    // it may extend over
+    window.clear();
+    text.visit(first, std::min(text.size(), last + size - 1),
+               [&](const char *block, Position count) {
+      window.append(block, count);
+      return true;
+    });
+    std::vector<Position> occurrences;
+    const char *window_end = window.data() + window.size();
+    for (const char *match = searcher.find(window.data(), window_end);
+         match != window_end; match = searcher.find(match + 1, window_end)) {
+      occurrences.push_back(first + (match - window.data()));
+    }
+    auto begin = std::lower_bound(matches.begin(), matches.end(), first);
+    auto end = std::lower_bound(begin, matches.end(), last);
+    begin = matches.erase(begin, end);
+    matches.insert(begin, occurrences.begin(), occurrences.end());
+  }
+  dirty.clear();
+}
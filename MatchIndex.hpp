@@ -0,0 +1,140 @@
+#ifndef MATCH_INDEX_HPP
+#define MATCH_INDEX_HPP
+/* MatchIndex.hpp
+ *
+ * The positions of every occurrence of a pattern in a TextBuffer, for
+ * highlighting and counting matches. The occurrences are first found on
+ * a worker thread in a snapshot of the buffer, so the editor stays
+ * responsive while a large file is searched. The snapshot is copied a
+ * slice per poll(), between which the editor handles input, so starting
+ * a search takes constant time. Edits made in the meantime are replayed
+ * on the result when it is collected, and from then on the index is
+ * kept up to date by rescanning only around each edit. Each edit also
+ * moves the positions of the occurrences after it, which takes time
+ * proportional to their number.
+ *
+ * EECS 280 List/Editor Project
+ */
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "TextBuffer.hpp"
+
+class MatchIndex {
+public:
+  using Position = TextBuffer::Position;
+
+  // Number of bytes the worker searches between checks for cancellation.
+  static const Position CHUNK_SIZE = 1 << 20;
+
+  // Number of bytes of the snapshot copied by each poll().
+  static const Position COPY_SIZE = 1 << 22;
+
+  //MODIFIES: text
+  //EFFECTS:  Creates an empty index of text, which observes its edits.
+  //          The text must outlive the index.
+  explicit MatchIndex(TextBuffer &text_in);
+
+  //MODIFIES: text
+  //EFFECTS:  Cancels any search in progress and stops observing the text.
+  ~MatchIndex();
+
+  MatchIndex(const MatchIndex &) = delete;
+  MatchIndex & operator=(const MatchIndex &) = delete;
+
+  //MODIFIES: *this
+  //EFFECTS:  Starts finding every occurrence of pattern, including
+  //          overlapping ones, canceling any stale search. The text is
+  //          copied by the following calls to poll(), and then searched
+  //          on a worker thread. An empty pattern clears the index.
+  void start(const std::string &pattern_in);
+
+  //MODIFIES: *this
+  //EFFECTS:  Cancels any search in progress and empties the index.
+  void clear();
+
+  //MODIFIES: *this
+  //EFFECTS:  Copies the next COPY_SIZE bytes of the snapshot, starting
+  //          the worker once it is complete, or else collects the result
+  //          of the worker if it has finished, bringing it up to date
+  //          with the edits made since the snapshot. Returns whether the
+  //          index is ready.
+  bool poll();
+
+  //EFFECTS: Returns whether the snapshot is still being copied.
+  bool copying() const;
+
+  //EFFECTS: Returns whether the snapshot is being copied, or the worker
+  //         is still searching.
+  bool pending() const;
+
+  //EFFECTS: Returns whether the index holds every occurrence of the
+  //         pattern in the text as it is now.
+  bool ready() const;
+
+  //EFFECTS: Returns the pattern being indexed, or an empty string.
+  const std::string & pattern() const;
+
+  //REQUIRES: ready()
+  //EFFECTS:  Returns the sorted start of each occurrence of the pattern.
+  const std::vector<Position> & positions() const;
+
+private:
+  // Range [first, last) of the text, in its current coordinates.
+  using Range = std::pair<Position, Position>;
+
+  TextBuffer &text;
+  int observer;
+  std::string needle;
+  std::vector<Position> matches;
+  bool is_ready;
+
+  // the snapshot for the worker while it is copied, and the index in the
+  // text of the next byte to copy
+  bool is_copying;
+  std::string snapshot;
+  Position copy_index;
+
+  // the worker, which writes found and then sets done
+  std::thread worker;
+  std::atomic<bool> cancel;
+  std::atomic<bool> done;
+  std::vector<Position> found;
+
+  // edits made to the text already in the snapshot, to replay on the
+  // result of the worker, and the ranges in which occurrences may have
+  // started or ended since
+  std::vector<TextBuffer::Edit> pending_edits;
+  std::vector<Range> dirty;
+
+  //MODIFIES: found, done
+  //EFFECTS:  Finds the occurrences of pattern in snapshot, unless
+  //          canceled. Runs on the worker thread.
+  void find_all(const std::string &pattern, const std::string &snapshot);
+
+  //MODIFIES: *this
+  //EFFECTS:  Stops the worker, if there is one.
+  void stop();
+
+  //MODIFIES: *this
+  //EFFECTS:  Updates the index (if ready) and dirty ranges for an edit.
+  //          While the snapshot is copied, an edit to the part already
+  //          copied is replayed later, and the rest of the snapshot is
+  //          copied from the edited text.
+  void handle_edit(const TextBuffer::Edit &edit);
+
+  //MODIFIES: matches
+  //EFFECTS:  Removes the occurrences that overlap the bytes removed by
+  //          edit, and moves the later ones.
+  void shift_matches(const TextBuffer::Edit &edit);
+
+  //MODIFIES: matches, dirty
+  //EFFECTS:  Rescans the text for occurrences that start in the dirty
+  //          ranges.
+  void rescan();
+};
+
+#endif // MATCH_INDEX_HPP
@@ -0,0 +1,160 @@
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MatchIndex.hpp"
+#include "unit_test_framework.hpp"
+
+using namespace std;
+
+using Position = MatchIndex::Position;
+
+// Returns the start of every occurrence of pattern in text.
+static vector<Position> occurrences(const string &text,
+                                    const string &pattern) {
+  vector<Position> found;
+  for (size_t i = text.find(pattern); i != string::npos;
+       i = text.find(pattern, i + 1)) {
+    found.push_back(i);
+  }
+  return found;
+}
+
+// Waits for the worker of index to finish.
+static void wait_for(MatchIndex &index) {
+  while (!index.poll()) {
+    this_thread::sleep_for(chrono::milliseconds(1));
+  }
+}
+
+// Applies a random edit to buffer.
+static void random_edit(TextBuffer &buffer) {
+  const string pieces[] = { "ab", "a", "b", "\n", "bab", "x" };
+  buffer.move_to_index(rand() % (buffer.size() + 1));
+  if (rand() % 2) {
+    const string &piece = pieces[rand() % 6];
+    buffer.insert(piece.data(), piece.size());
+  } else {
+    buffer.erase(min<Position>(rand() % 4,
+                               buffer.size() - buffer.get_index()));
+  }
+}
+
+TEST(test_finds_overlapping) {
+  TextBuffer buffer;
+  string text = "abababa\nxaba";
+  buffer.insert(text.data(), text.size());
+  MatchIndex index(buffer);
+  ASSERT_FALSE(index.ready());
+  index.start("aba");
+  wait_for(index);
+  ASSERT_FALSE(index.pending());
+  ASSERT_EQUAL(index.pattern(), "aba");
+  ASSERT_TRUE(index.positions() == vector<Position>({ 0, 2, 4, 9 }));
+  index.start("");
+  ASSERT_FALSE(index.ready());
+  ASSERT_FALSE(index.pending());
+}
+
+TEST(test_chunks) {
+  // occurrences across chunk boundaries are found once
+  string text;
+  for (int i = 0; text.size() < 3 * MatchIndex::CHUNK_SIZE; ++i) {
+    text += i % 7 ? "abc " : "aab";
+  }
+  TextBuffer buffer;
+  buffer.insert(text.data(), text.size());
+  MatchIndex index(buffer);
+  index.start("ab");
+  wait_for(index);
+  ASSERT_TRUE(index.positions() == occurrences(text, "ab"));
+}
+
+TEST(test_edits_after_ready) {
+  srand(36);
+  TextBuffer buffer;
+  buffer.insert("abba bab\nab", 11);
+  MatchIndex index(buffer);
+  index.start("bab");
+  wait_for(index);
+  for (int step = 0; step < 2000; ++step) {
+    random_edit(buffer);
+    ASSERT_TRUE(index.ready());
+    ASSERT_TRUE(index.positions()
+                == occurrences(buffer.stringify(), "bab"));
+  }
+}
+
+TEST(test_edits_while_pending) {
+  srand(280);
+  string text;
+  while (text.size() < 2000000) {
+    text += "ab ba bab a";
+  }
+  for (int trial = 0; trial < 3; ++trial) {
+    TextBuffer buffer;
+    buffer.insert(text.data(), text.size());
+    MatchIndex index(buffer);
+    index.start("bab");
+    for (int step = 0; step < 20; ++step) {
+      random_edit(buffer);
+    }
+    buffer.begin_batch();
+    random_edit(buffer);
+    random_edit(buffer);
+    buffer.end_batch();
+    wait_for(index);
+    ASSERT_TRUE(index.positions()
+                == occurrences(buffer.stringify(), "bab"));
+  }
+}
+
+TEST(test_edits_while_copying) {
+  srand(2);
+  string text;
+  while (text.size() < 3 * MatchIndex::COPY_SIZE) {
+    text += "ab ba bab a";
+  }
+  for (int trial = 0; trial < 3; ++trial) {
+    TextBuffer buffer;
+    buffer.insert(text.data(), text.size());
+    MatchIndex index(buffer);
+    index.start("bab");
+    index.poll();
+    ASSERT_TRUE(index.copying());
+    // before, across and after the end of the copied slice
+    Position copied = MatchIndex::COPY_SIZE;
+    buffer.move_to_index(copied - 5);
+    buffer.insert("bab", 3);
+    buffer.move_to_index(copied + 1);
+    buffer.erase(3);
+    buffer.move_to_index(copied + 10);
+    buffer.insert("ab", 2);
+    while (index.copying()) {
+      for (int step = 0; step < 10; ++step) {
+        random_edit(buffer);
+      }
+      index.poll();
+    }
+    wait_for(index);
+    ASSERT_TRUE(index.positions()
+                == occurrences(buffer.stringify(), "bab"));
+  }
+}
+
+TEST(test_restart_cancels) {
+  string text(3000000, 'a');
+  TextBuffer buffer;
+  buffer.insert(text.data(), text.size());
+  buffer.insert("b", 1);
+  MatchIndex index(buffer);
+  index.start("a");
+  index.start("ab");
+  wait_for(index);
+  ASSERT_EQUAL(index.pattern(), "ab");
+  ASSERT_TRUE(index.positions() == vector<Position>({ 2999999 }));
+  index.start("a"); // canceled by the destructor
+}
+
+TEST_MAIN()
@@ -0,0 +1,748 @@
+#include "Regex.hpp"
+#include "CharScan.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstring>
+
+using Position = Regex::Position;
+using ByteSet = std::bitset<256>;
+using Instruction = Regex::Instruction;
+
+namespace {
+
+const int MAX_REPEAT = 1000;
+
+// Returns whether c is a UTF-8 continuation byte (10xxxxxx).
+bool is_continuation(unsigned char c) {
+  return (c & 0xC0) == 0x80;
+}
+
+// Returns the set of bytes in [low, high].
+ByteSet byte_range(int low, int high) {
+  ByteSet set;
+  for (int c = low; c <= high; ++c) {
+    set.set(c);
+  }
+  return set;
+}
+
+// Node of a parsed pattern.
+struct Node {
+  enum Kind {
+    EMPTY,      // matches the empty string
+    BYTE,       // matches one byte in bytes
+    CONCAT,     // matches its children in sequence
+    ALTERNATE,  // matches any one of its children
+    REPEAT,     // matches its child min to max times (max -1: unbounded)
+    LINE_START,
+    LINE_END
+  } kind;
+  ByteSet bytes;
+  std::vector<int> children;
+  int min;
+  int max;
+};
+
+// Recursive descent parser from a pattern to a tree of Nodes, and
+// compiler from the tree to a program.
+class Parser {
+public:
+  std::vector<Node> nodes;
+  std::string error;
+
+  Parser(const std::string &pattern_in, bool utf8_in)
+    : pattern(pattern_in), pos(0), utf8(utf8_in) {}
+
+  //EFFECTS: Parses the pattern, returning the root node, or -1 and
+  //         setting error if it is invalid.
+  int parse() {
+    int root = parse_alternation();
+    if (root != -1 && pos < pattern.size()) {
+      return fail("unmatched )");
+    }
+    return root;
+  }
+
+  //EFFECTS: Compiles the tree at root into program and byte_sets,
+  //         returning false and setting error if it is too large.
+  bool compile(int root, std::vector<Instruction> &program,
+               std::vector<ByteSet> &byte_sets) {
+    emit(root, program, byte_sets);
+    program.push_back({ Instruction::MATCH, 0, 0, 0 });
+    if (program.size() > static_cast<std::size_t>(Regex::MAX_PROGRAM)) {
+      error = "pattern is too large";
+      return false;
+    }
+    return true;
+  }
+
+private:
+  const std::string &pattern;
+  std::size_t pos;
+  bool utf8;
+
+  bool reject(const std::string &message) {
+    if (error.empty()) {
+      error = message;
+    }
+    return false;
+  }
+
+  int fail(const std::string &message) {
+    reject(message);
+    return -1;
+  }
+
+  int add(Node::Kind kind, std::vector<int> children = {}) {
+    nodes.push_back({ kind, ByteSet(), std::move(children), 0, 0 });
+    return nodes.size() - 1;
+  }
+
+  int add_bytes(const ByteSet &bytes) {
+    int node = add(Node::BYTE);
+    nodes[node].bytes = bytes;
+    return node;
+  }
+
+  bool at(char c) const {
+    return pos < pattern.size() && pattern[pos] == c;
+  }
+
+  // alternation := concatenation ('|' concatenation)*
+  int parse_alternation() {
+    std::vector<int> branches = { parse_concatenation() };
+    while (branches.back() != -1 && at('|')) {
+      ++pos;
+      branches.push_back(parse_concatenation());
+    }
+    if (branches.back() == -1) {
+      return -1;
+    }
+    return branches.size() == 1 ? branches[0]
+      : add(Node::ALTERNATE, branches);
+  }
+
+  // concatenation := repetition*
+  int parse_concatenation() {
+    std::vector<int> parts;
+    while (pos < pattern.size() && !at('|') && !at(')')) {
+      int part = parse_repetition();
+      if (part == -1) {
+        return -1;
+      }
+      parts.push_back(part);
+    }
+    return parts.size() == 1 ? parts[0] : add(Node::CONCAT, parts);
+  }
+
+  // repetition := atom ('*' | '+' | '?' | '{' m [',' [n]] '}')*
+  int parse_repetition() {
+    int atom = parse_atom();
+    while (atom != -1 && pos < pattern.size()) {
+      int min, max;
+      char c = pattern[pos];
+      if (c == '*' || c == '+' || c == '?') {
+        ++pos;
+        min = (c == '+');
+        max = (c == '?' ? 1 : -1);
+      } else if (c == '{' && pos + 1 < pattern.size()
+                 && std::isdigit(
+                   static_cast<unsigned char>(pattern[pos + 1]))) {
+        ++pos;
+        if (!parse_interval(min, max)) {
+          return -1;
+        }
+      } else {
+        break;
+      }
+      int repeat = add(Node::REPEAT, { atom });
+      nodes[repeat].min = min;
+      nodes[repeat].max = max;
+      atom = repeat;
+    }
+    return atom;
+  }
+
+  // Parses m[,[n]]} after a '{'.
+  bool parse_interval(int &min, int &max) {
+    min = parse_number();
+    max = min;
+    if (at(',')) {
+      ++pos;
+      max = at('}') ? -1 : parse_number();
+    }
+    if (!at('}')) {
+      return reject("malformed {m,n}");
+    }
+    ++pos;
+    if (min > MAX_REPEAT || max > MAX_REPEAT) {
+      return reject("repetition count is too large");
+    } else if (max != -1 && max < min) {
+      return reject("bad {m,n}: n < m");
+    }
+    return true;
+  }
+
+  int parse_number() {
+    int number = 0;
+    while (pos < pattern.size()
+           && std::isdigit(static_cast<unsigned char>(pattern[pos]))) {
+      number = std::min(10 * number + (pattern[pos++] - '0'),
+                        MAX_REPEAT + 1);
+    }
+    return number;
+  }
+
+  // atom := '(' alternation ')' | '[' class ']' | '.' | '^' | '$'
+  //       | '\' escape | character
+  int parse_atom() {
+    char c = pattern[pos++];
+    switch (c) {
+    case '(': {
+      int inner = at(')') ? add(Node::EMPTY) : parse_alternation();
+      if (inner == -1) {
+        return -1;
+      } else if (!at(')')) {
+        return fail("unmatched (");
+      }
+      ++pos;
+      return inner;
+    }
+    case '[':
+      return parse_class();
+    case '.':
+      return add_negated(ByteSet().set('\n'));
+    case '^':
+      return add(Node::LINE_START);
+    case '$':
+      return add(Node::LINE_END);
+    case '*': case '+': case '?':
+      return fail(std::string("nothing to repeat before ") + c);
+    case '\\': {
+      ByteSet bytes;
+      bool negated;
+      if (!parse_escape(bytes, negated)) {
+        return -1;
+      }
+      return negated ? add_negated(bytes) : add_bytes(bytes);
+    }
+    default:
+      --pos;
+      return add_sequence(parse_character());
+    }
+  }
+
+  // Parses the escape after a '\' into the set of bytes it stands for,
+  // or its complement if negated is set.
+  bool parse_escape(ByteSet &bytes, bool &negated) {
+    if (pos == pattern.size()) {
+      return reject("trailing \\");
+    }
+    unsigned char c = pattern[pos++];
+    negated = std::isupper(c) && std::strchr("DWS", c);
+    switch (std::tolower(c)) {
+    case 'd':
+      bytes = byte_range('0', '9');
+      return true;
+    case 'w':
+      bytes = byte_range('0', '9') | byte_range('A', 'Z')
+        | byte_range('a', 'z') | ByteSet().set('_');
+      return true;
+    case 's':
+      for (char space : std::string(" \t\n\r\f\v")) {
+        bytes.set(static_cast<unsigned char>(space));
+      }
+      return true;
+    }
+    negated = false;
+    const char *controls = "n\nt\tr\rf\fv\v";
+    for (const char *p = controls; *p; p += 2) {
+      if (c == *p) {
+        bytes.set(static_cast<unsigned char>(p[1]));
+        return true;
+      }
+    }
+    if (std::isalnum(c)) {
+      return reject(std::string("unknown escape \\")
+                    + static_cast<char>(c));
+    }
+    bytes.set(c);
+    return true;
+  }
+
+  // Reads one character: a UTF-8 sequence in UTF-8 mode (or a stray
+  // byte), otherwise a single byte.
+  std::string parse_character() {
+    std::size_t start = pos++;
+    if (utf8 && static_cast<unsigned char>(pattern[start]) >= 0xC0) {
+      while (pos < pattern.size()
+             && is_continuation(static_cast<unsigned char>(pattern[pos]))) {
+        ++pos;
+      }
+    }
+    return pattern.substr(start, pos - start);
+  }
+
+  // Adds a node matching the given sequence of bytes.
+  int add_sequence(const std::string &sequence) {
+    std::vector<int> bytes;
+    for (unsigned char c : sequence) {
+      bytes.push_back(add_bytes(ByteSet().set(c)));
+    }
+    return bytes.size() == 1 ? bytes[0] : add(Node::CONCAT, bytes);
+  }
+
+  // Adds a node matching any character but a newline or one in the
+  // given set of bytes, which must be ASCII in UTF-8 mode.
+  int add_negated(const ByteSet &excluded) {
+    ByteSet bytes = ~excluded;
+    bytes.reset('\n');
+    if (!utf8) {
+      return add_bytes(bytes);
+    }
+    // an ASCII character, or a lead byte and its continuation bytes
+    int ascii = add_bytes(bytes & byte_range(0, 0x7F));
+    int lead = add_bytes(byte_range(0xC0, 0xFF));
+    int continuations = add(Node::REPEAT, { add_bytes(byte_range(0x80,
+                                                                 0xBF)) });
+    nodes[continuations].min = 0;
+    nodes[continuations].max = -1;
+    return add(Node::ALTERNATE,
+               { ascii, add(Node::CONCAT, { lead, continuations }) });
+  }
+
+  // class := '^'? ']'? (item | item '-' item | '\' escape)* ']'
+  int parse_class() {
+    bool negated = at('^');
+    pos += negated;
+    ByteSet bytes;
+    std::vector<std::string> sequences; // multibyte UTF-8 members
+    bool first = true;
+    while (pos < pattern.size() && (first || !at(']'))) {
+      first = false;
+      if (at('\\')) {
+        ++pos;
+        ByteSet escaped;
+        bool escape_negated;
+        if (!parse_escape(escaped, escape_negated)) {
+          return -1;
+        } else if (escape_negated) {
+          return fail("negated escapes are not allowed in [...]");
+        }
+        bytes |= escaped;
+        continue;
+      }
+      std::string low = parse_character();
+      if (at('-') && pos + 1 < pattern.size() && pattern[pos + 1] != ']') {
+        ++pos;
+        std::string high = parse_character();
+        if (low.size() > 1 || high.size() > 1
+            || (utf8 && (static_cast<unsigned char>(low[0]) > 0x7F
+                         || static_cast<unsigned char>(high[0]) > 0x7F))) {
+          return fail("ranges in [...] must be ASCII");
+        } else if (low[0] > high[0]) {
+          return fail("bad range in [...]");
+        }
+        bytes |= byte_range(static_cast<unsigned char>(low[0]),
+                            static_cast<unsigned char>(high[0]));
+      } else if (low.size() > 1) {
+        sequences.push_back(low);
+      } else {
+        bytes.set(static_cast<unsigned char>(low[0]));
+      }
+    }
+    if (!at(']')) {
+      return fail("unmatched [");
+    }
+    ++pos;
+    if (negated) {
+      if (!sequences.empty() || (utf8 && (bytes & byte_range(0x80, 0xFF))
+                                           .any())) {
+        return fail("[^...] may only exclude ASCII characters");
+      }
+      return add_negated(bytes);
+    }
+    std::vector<int> members = { add_bytes(bytes) };
+    for (const std::string &sequence : sequences) {
+      members.push_back(add_sequence(sequence));
+    }
+    return members.size() == 1 ? members[0]
+      : add(Node::ALTERNATE, members);
+  }
+
+  // Appends the instructions for the tree at node to program.
+  void emit(int node, std::vector<Instruction> &program,
+            std::vector<ByteSet> &byte_sets) {
+    if (program.size() > static_cast<std::size_t>(Regex::MAX_PROGRAM)) {
+      return; // compile() reports the error
+    }
+    const Node &n = nodes[node];
+    switch (n.kind) {
+    case Node::EMPTY:
+      break;
+    case Node::BYTE:
+      byte_sets.push_back(n.bytes);
+      program.push_back({ Instruction::BYTE, 0, 0,
+                          static_cast<int>(byte_sets.size()) - 1 });
+      break;
+    case Node::CONCAT:
+      for (int child : n.children) {
+        emit(child, program, byte_sets);
+      }
+      break;
+    case Node::ALTERNATE: {
+      std::vector<int> jumps;
+      for (std::size_t i = 0; i + 1 < n.children.size(); ++i) {
+        int split = program.size();
+        program.push_back({ Instruction::SPLIT, split + 1, 0, 0 });
+        emit(n.children[i], program, byte_sets);
+        jumps.push_back(program.size());
+        program.push_back({ Instruction::JUMP, 0, 0, 0 });
+        program[split].y = program.size();
+      }
+      emit(n.children.back(), program, byte_sets);
+      for (int jump : jumps) {
+        program[jump].x = program.size();
+      }
+      break;
+    }
+    case Node::REPEAT:
+      emit_repeat(n, program, byte_sets);
+      break;
+    case Node::LINE_START:
+      program.push_back({ Instruction::LINE_START, 0, 0, 0 });
+      break;
+    case Node::LINE_END:
+      program.push_back({ Instruction::LINE_END, 0, 0, 0 });
+      break;
+    }
+  }
+
+  // Emits min copies of the child, then either a loop or max - min
+  // optional copies.
+  void emit_repeat(const Node &n, std::vector<Instruction> &program,
+                   std::vector<ByteSet> &byte_sets) {
+    int child = n.children[0];
+    for (int i = 0; i < n.min; ++i) {
+      emit(child, program, byte_sets);
+    }
+    if (n.max == -1) {
+      int split = program.size();
+      program.push_back({ Instruction::SPLIT, split + 1, 0, 0 });
+      emit(child, program, byte_sets);
+      program.push_back({ Instruction::JUMP, split, 0, 0 });
+      program[split].y = program.size();
+      return;
+    }
+    for (int i = n.min; i < n.max; ++i) {
+      int split = program.size();
+      program.push_back({ Instruction::SPLIT, split + 1, 0, 0 });
+      emit(child, program, byte_sets);
+      program[split].y = program.size();
+    }
+  }
+};
+
+} // namespace
+
+Regex::Regex(const std::string &pattern, bool utf8)
+  : tracks_lines(false), idle_exit(-1), generation(0) {
+  Parser parser(pattern, utf8);
+  int root = parser.parse();
+  if (root == -1 || !parser.compile(root, program, byte_sets)) {
+    error_message = parser.error;
+    program.clear();
+    return;
+  }
+  marks.assign(program.size(), 0);
+  for (const Instruction &instruction : program) {
+    tracks_lines |= (instruction.op == Instruction::LINE_START);
+  }
+  reset_dfa();
+  // find the bytes that leave the idle state
+  int exits = 0;
+  for (int c = 0; c < 256; ++c) {
+    if (dfa_step(IDLE, c) != 2 * IDLE) {
+      idle_exit = c;
+      ++exits;
+    }
+  }
+  if (exits != 1) {
+    idle_exit = -1;
+  }
+}
+
+const std::string & Regex::error() const {
+  return error_message;
+}
+
+bool Regex::search(const char *first, const char *last, Match &match) {
+  return search(first, last, 0, match);
+}
+
+bool Regex::search(const char *first, const char *last, Position from,
+                   Match &match) {
+  Visit visit = [first](Position from, Position to,
+                        const TextBuffer::BlockVisitor &visitor) {
+    if (from < to) {
+      visitor(first + from, to - from);
+    }
+  };
+  return search(visit, last - first, from, last - first,
+                from == 0 || first[from - 1] == '\n', match);
+}
+
+bool Regex::find_in(const TextBuffer &text, Position first, Position last,
+                    Match &match) {
+  Visit visit = [&text](Position from, Position to,
+                        const TextBuffer::BlockVisitor &visitor) {
+    text.visit(from, to, visitor);
+  };
+  bool line_start = (first == 0);
+  if (!line_start) {
+    visit(first - 1, first, [&](const char *block, Position) {
+      line_start = (*block == '\n');
+      return true;
+    });
+  }
+  return search(visit, text.size(), first, last, line_start, match);
+}
+
+bool Regex::rfind_in(const TextBuffer &text, Position first, Position last,
+                     Match &match) {
+  bool found = false;
+  Match next;
+  while (first <= last && find_in(text, first, last, next)) {
+    match = next;
+    found = true;
+    first = next.start + 1;
+  }
+  return found;
+}
+
+bool Regex::search(const Visit &visit, Position size, Position first,
+                   Position last, bool line_start, Match &match) {
+  assert(error_message.empty());
+  assert(0 <= first && first <= last && last <= size);
+  Position resume;
+  bool resume_line_start;
+  bool at_end = (last == size);
+  if (!scan(visit, first, last, at_end, line_start, resume,
+            resume_line_start)) {
+    return false;
+  }
+  // a match may start at the end of the text, if that is in range
+  return simulate(visit, size, resume, at_end ? size + 1 : last,
+                  resume_line_start, match);
+}
+
+bool Regex::scan(const Visit &visit, Position first, Position last,
+                 bool at_end, bool line_start, Position &resume,
+                 bool &resume_line_start) {
+  int state = line_start ? IDLE_LINE_START : IDLE;
+  resume = first;
+  resume_line_start = line_start;
+  bool matched = false;
+  Position position = first;
+  visit(first, last, [&](const char *block, Position count) {
+    // the cache only changes in dfa_step(), so keep its address and the
+    // last idle offset in locals to keep the inner loop tight
+    const DfaState *states = dfa_states.data();
+    Position idle = -1;
+    int idle_state = state;
+    for (Position i = 0; i < count; ++i) {
+      if (state == IDLE && idle_exit != -1) {
+        // skip to the only byte that can start a match
+        Position exit = find_char(block + i, block + count, idle_exit)
+          - block;
+        if (exit > i) {
+          idle = exit - 1;
+          idle_state = IDLE;
+          i = exit;
+          if (i == count) {
+            break;
+          }
+        }
+      }
+      unsigned char c = block[i];
+      int next = states[state].next[c];
+      if (next < 0) {
+        next = dfa_step(state, c);
+        states = dfa_states.data();
+      }
+      if (next & 1) { // a match ends before c
+        matched = true;
+        break;
+      }
+      state = next >> 1;
+      if (state <= IDLE_LINE_START) { // no match in progress
+        idle = i;
+        idle_state = state;
+      }
+    }
+    if (idle != -1) {
+      resume = position + idle + 1;
+      resume_line_start = (idle_state == IDLE_LINE_START);
+    }
+    position += count;
+    return !matched;
+  });
+  if (matched || state > IDLE_LINE_START) {
+    return true; // a match may still be in progress at last
+  } else if (!at_end) {
+    return false;
+  }
+  // an empty match may be at the end of the text
+  ++generation;
+  std::vector<int> consumers;
+  return follow(0, state == IDLE_LINE_START, -1, consumers);
+}
+
+bool Regex::simulate(const Visit &visit, Position size, Position first,
+                     Position last, bool line_start, Match &match) {
+  // threads in progress, by pc and start, in order of start; a pc is
+  // only kept for the earliest start that reaches it
+  std::vector<std::pair<int, Position>> threads, next_threads;
+  std::vector<unsigned> next_marks(program.size(), 0);
+  std::vector<int> consumers;
+  bool found = false;
+  Position position = first;
+  // Processes the byte c (or the end of the text if c is -1) at
+  // position, and returns whether the match may still grow.
+  auto step = [&](int c) {
+    if (!found && position < last) {
+      threads.push_back({ 0, position });
+    }
+    ++generation;
+    next_threads.clear();
+    for (const auto &thread : threads) {
+      if (found && thread.second > match.start) {
+        break; // later threads start even later
+      }
+      consumers.clear();
+      if (follow(thread.first, line_start, c, consumers)
+          && (!found || thread.second < match.start
+              || position > match.end)) {
+        match = { thread.second, position };
+        found = true;
+      }
+      for (int pc : consumers) {
+        if (next_marks[pc + 1] != generation) {
+          next_marks[pc + 1] = generation;
+          next_threads.push_back({ pc + 1, thread.second });
+        }
+      }
+    }
+    threads.swap(next_threads);
+    line_start = (c == '\n');
+    ++position;
+    return !threads.empty() || (!found && position < last);
+  };
+  // matches starting before last may extend to the end of the text
+  bool done = false;
+  visit(first, size, [&](const char *block, Position count) {
+    for (Position i = 0; i < count; ++i) {
+      if (!step(static_cast<unsigned char>(block[i]))) {
+        done = true;
+        return false;
+      }
+    }
+    return true;
+  });
+  if (!done) {
+    step(-1);
+  }
+  return found;
+}
+
+int Regex::dfa_step(int state, unsigned char c) {
+  ++generation;
+  std::vector<int> consumers;
+  bool matched = follow(0, dfa_states[state].line_start, c, consumers);
+  for (int pc : dfa_states[state].threads) {
+    matched |= follow(pc, dfa_states[state].line_start, c, consumers);
+  }
+  std::vector<int> threads;
+  for (int pc : consumers) {
+    threads.push_back(pc + 1);
+  }
+  std::sort(threads.begin(), threads.end());
+  threads.erase(std::unique(threads.begin(), threads.end()), threads.end());
+  std::size_t states_before = dfa_states.size();
+  int next = dfa_state(threads, tracks_lines && c == '\n');
+  int transition = 2 * next + matched;
+  if (dfa_states.size() >= states_before) { // state was not flushed
+    dfa_states[state].next[c] = transition;
+  }
+  return transition;
+}
+
+int Regex::dfa_state(const std::vector<int> &threads, bool line_start) {
+  auto found = dfa_index.find({ threads, line_start });
+  if (found != dfa_index.end()) {
+    return found->second;
+  }
+  if (dfa_states.size() >= static_cast<std::size_t>(MAX_DFA_STATES)) {
+    reset_dfa();
+  }
+  DfaState state = { threads, line_start, {} };
+  state.next.fill(-1);
+  dfa_states.push_back(state);
+  dfa_index[{ threads, line_start }] = dfa_states.size() - 1;
+  return dfa_states.size() - 1;
+}
+
+void Regex::reset_dfa() {
+  dfa_states.clear();
+  dfa_index.clear();
+  for (bool line_start : { false, true }) {
+    DfaState state = { {}, line_start, {} };
+    state.next.fill(-1);
+    dfa_states.push_back(state);
+    dfa_index[{ {}, line_start }] = dfa_states.size() - 1;
+  }
+}
+
+bool Regex::follow(int pc, bool line_start, int next,
+                   std::vector<int> &consumers) {
+  bool matched = false;
+  stack.push_back(pc);
+  while (!stack.empty()) {
+    pc = stack.back();
+    stack.pop_back();
+    if (marks[pc] == generation) {
+      continue;
+    }
+    marks[pc] = generation;
+    const Instruction &instruction = program[pc];
+    switch (instruction.op) {
+    case Instruction::BYTE:
+      if (next != -1 && byte_sets[instruction.set][next]) {
+        consumers.push_back(pc);
+      }
+      break;
+    case Instruction::SPLIT:
+      stack.push_back(instruction.y);
+      stack.push_back(instruction.x);
+      break;
+    case Instruction::JUMP:
+      stack.push_back(instruction.x);
+      break;
+    case Instruction::LINE_START:
+      if (line_start) {
+        stack.push_back(pc + 1);
+      }
+      break;
+    case Instruction::LINE_END:
+      if (next == -1 || next == '\n') {
+        stack.push_back(pc + 1);
+      }
+      break;
+    case Instruction::MATCH:
+      matched = true;
+      break;
+    }
+  }
+  return matched;
+}
@@ -0,0 +1,193 @@
+#ifndef REGEX_HPP
+#define REGEX_HPP
+/* Regex.hpp
+ *
+ * Regular expression search over contiguous text and over the contents
+ * of a TextBuffer, without backtracking and without copying the buffer.
+ *
+ * A pattern is compiled to a Thompson NFA. Searches first run a lazily
+ * built DFA over the text, one table lookup per byte, until a match
+ * ends. The match is then pinned down by simulating the NFA from the
+ * last point where no partial match was in progress. Both phases take
+ * time linear in the length of the text.
+ *
+ * Matches are leftmost-longest, as in POSIX. The syntax is that of
+ * POSIX extended regular expressions, without backreferences:
+ *   .  [abc]  [^a-z]  ^  $  (...)  |  *  +  ?  {m}  {m,}  {m,n}
+ * plus the escapes \d \w \s \D \W \S \n \t \r \f \v, and \ followed by
+ * any punctuation character for that character. ^ and $ match at the
+ * start and end of each line. Neither . nor negated classes match a
+ * newline. In UTF-8 mode, . and negated classes match a whole UTF-8
+ * character, and so do literal characters and bracket expression
+ * members; ranges must be ASCII.
+ *
+ * EECS 280 List/Editor Project
+ */
+
+#include <array>
+#include <bitset>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "TextBuffer.hpp"
+
+class Regex {
+public:
+  using Position = TextBuffer::Position;
+
+  // Bytes [start, end) of a match.
+  struct Match {
+    Position start;
+    Position end;
+  };
+
+  // Instruction of a compiled program.
+  struct Instruction {
+    enum Opcode {
+      BYTE,       // consume a byte in byte_sets[set], continue at pc + 1
+      SPLIT,      // continue at both x and y
+      JUMP,       // continue at x
+      LINE_START, // continue at pc + 1 at the start of a line
+      LINE_END,   // continue at pc + 1 at the end of a line
+      MATCH       // a match ends here
+    } op;
+    int x;
+    int y;
+    int set;
+  };
+
+  // Largest number of instructions a pattern may compile to.
+  static const int MAX_PROGRAM = 20000;
+
+  // Number of DFA states cached before the cache is flushed.
+  static const int MAX_DFA_STATES = 2000;
+
+  //EFFECTS: Compiles the given pattern, treating the pattern and the
+  //         text it is matched against as UTF-8 if utf8 is true. If the
+  //         pattern is invalid, error() describes why.
+  Regex(const std::string &pattern, bool utf8);
+
+  //EFFECTS: Returns a description of what is wrong with the pattern,
+  //         or an empty string if it compiled.
+  const std::string & error() const;
+
+  //REQUIRES: error() is empty, and [first, last) is a valid range
+  //MODIFIES: the DFA cache
+  //EFFECTS:  Finds the leftmost-longest match in the range, with
+  //          indices relative to first. Returns whether there is one.
+  bool search(const char *first, const char *last, Match &match);
+
+  //REQUIRES: error() is empty, [first, last) is a valid range, and
+  //          0 <= from <= last - first
+  //MODIFIES: the DFA cache
+  //EFFECTS:  Like search(first, last, match), but finds the
+  //          leftmost-longest match that starts at or after first + from.
+  //          The byte before it decides whether ^ matches there.
+  bool search(const char *first, const char *last, Position from,
+              Match &match);
+
+  //REQUIRES: error() is empty, and 0 <= first <= last <= text.size()
+  //MODIFIES: the DFA cache
+  //EFFECTS:  Finds the leftmost-longest match in text that starts in
+  //          [first, last), which may extend past last. An empty match at
+  //          the end of the text counts if last is the end of the text.
+  //          Returns whether there is one. The cursor does not move.
+  bool find_in(const TextBuffer &text, Position first, Position last,
+               Match &match);
+
+  //REQUIRES: error() is empty, and 0 <= first <= last <= text.size()
+  //MODIFIES: the DFA cache
+  //EFFECTS:  Finds the last match in text that starts in [first, last)
+  //          (as for find_in()), by searching forward from each earlier
+  //          match.
+  //          Returns whether there is one. The cursor does not move.
+  bool rfind_in(const TextBuffer &text, Position first, Position last,
+                Match &match);
+
+private:
+  // Function that calls visitor with the bytes in [from, to) of a text.
+  using Visit = std::function<void(Position from, Position to,
+                                   const TextBuffer::BlockVisitor &)>;
+
+  // A state of the lazy DFA: the NFA threads in progress and whether the
+  // previous byte ended a line. Transitions are computed on first use;
+  // each is -1 or twice the next state, plus 1 if a match ends before
+  // the byte.
+  struct DfaState {
+    std::vector<int> threads;
+    bool line_start;
+    std::array<int, 256> next;
+  };
+
+  // DFA states with no threads in progress, after a newline or not.
+  static const int IDLE = 0;
+  static const int IDLE_LINE_START = 1;
+
+  std::string error_message;
+  std::vector<Instruction> program;
+  std::vector<std::bitset<256>> byte_sets;
+
+  // whether the pattern uses ^, so that DFA states must record whether
+  // they are at the start of a line
+  bool tracks_lines;
+
+  // the only byte on which the DFA leaves the IDLE state, or -1 if there
+  // is not exactly one; the DFA skips ahead to it with find_char()
+  int idle_exit;
+
+  std::vector<DfaState> dfa_states;
+  std::map<std::pair<std::vector<int>, bool>, int> dfa_index;
+
+  // scratch space for following instructions
+  std::vector<unsigned> marks; // generation in which each pc was seen
+  unsigned generation;
+  std::vector<int> stack;
+
+  //REQUIRES: error() is empty, 0 <= first <= last <= size, and
+  //          line_start is whether first is at the start of a line
+  //EFFECTS:  Finds the leftmost-longest match that starts in
+  //          [first, last) in a text of the given size, read by visit.
+  bool search(const Visit &visit, Position size, Position first,
+              Position last, bool line_start, Match &match);
+
+  //EFFECTS: Runs the DFA over [first, last), where at_end is whether
+  //         last is the end of the text. Returns whether a match may
+  //         start there, and sets resume to a position at or before the
+  //         start of any match, with resume_line_start for it.
+  bool scan(const Visit &visit, Position first, Position last, bool at_end,
+            bool line_start, Position &resume, bool &resume_line_start);
+
+  //EFFECTS: Simulates the NFA from first, which is not inside a match,
+  //         to find the leftmost-longest match starting in [first, last)
+  //         in a text of the given size.
+  bool simulate(const Visit &visit, Position size, Position first,
+                Position last, bool line_start, Match &match);
+
+  //MODIFIES: the DFA cache
+  //EFFECTS:  Computes, caches and returns the transition of the given
+  //          DFA state on byte c.
+  int dfa_step(int state, unsigned char c);
+
+  //MODIFIES: the DFA cache
+  //EFFECTS:  Returns the index of the DFA state with the given threads
+  //          and flag, adding it if it is new (which may flush the
+  //          cache first).
+  int dfa_state(const std::vector<int> &threads, bool line_start);
+
+  //MODIFIES: the DFA cache
+  //EFFECTS:  Empties the DFA cache, leaving only the idle states.
+  void reset_dfa();
+
+  //MODIFIES: marks, stack
+  //EFFECTS:  Follows the instructions reachable from pc without
+  //          consuming a byte, where next is the next byte (or -1 at
+  //          the end of the text), skipping those already seen in this
+  //          generation. Appends the BYTE instructions that consume next
+  //          to consumers, and returns whether a MATCH was reached.
+  bool follow(int pc, bool line_start, int next,
+              std::vector<int> &consumers);
+};
+
+#endif // REGEX_HPP
@@ -0,0 +1,208 @@
+#include <cstdlib>
+#include <regex>
+#include <string>
+#include "Regex.hpp"
+#include "Search.hpp"
+#include "unit_test_framework.hpp"
+
+using namespace std;
+
+using Position = Regex::Position;
+
+// Searches text for pattern, returning "start,end" or "none".
+static string search(const string &pattern, const string &text,
+                     bool utf8 = false) {
+  Regex regex(pattern, utf8);
+  ASSERT_EQUAL(regex.error(), "");
+  Regex::Match match;
+  if (!regex.search(text.data(), text.data() + text.size(), match)) {
+    return "none";
+  }
+  return to_string(match.start) + "," + to_string(match.end);
+}
+
+// Returns the leftmost-longest match of pattern in text, found by
+// trying every substring with std::regex_match.
+static string reference_search(const string &pattern, const string &text) {
+  regex reference(pattern, regex::extended);
+  for (size_t start = 0; start <= text.size(); ++start) {
+    for (size_t end = text.size() + 1; end-- > start;) {
+      if (regex_match(text.begin() + start, text.begin() + end, reference)) {
+        return to_string(start) + "," + to_string(end);
+      }
+    }
+  }
+  return "none";
+}
+
+// Builds a random pattern over the letters a to c.
+static string random_pattern(int depth) {
+  int choice = rand() % (depth > 0 ? 9 : 4);
+  switch (choice) {
+  case 0: case 1: case 2:
+    return string(1, 'a' + rand() % 3);
+  case 3:
+    return rand() % 2 ? "." : "[ab]";
+  case 4:
+    return random_pattern(depth - 1) + random_pattern(depth - 1);
+  case 5:
+    return "(" + random_pattern(depth - 1) + "|"
+      + random_pattern(depth - 1) + ")";
+  case 6:
+    return "(" + random_pattern(depth - 1) + ")*";
+  case 7:
+    return "(" + random_pattern(depth - 1) + ")+";
+  default:
+    return "(" + random_pattern(depth - 1) + "){1,2}";
+  }
+}
+
+TEST(test_literals_and_operators) {
+  ASSERT_EQUAL(search("abc", "xxabcxx"), "2,5");
+  ASSERT_EQUAL(search("abd", "xxabcxx"), "none");
+  ASSERT_EQUAL(search("a|b", "xxbxa"), "2,3");
+  ASSERT_EQUAL(search("ab*", "xabbbc"), "1,5");
+  ASSERT_EQUAL(search("ab+c", "xacabcx"), "3,6");
+  ASSERT_EQUAL(search("colou?r", "the color"), "4,9");
+  ASSERT_EQUAL(search("a{2,3}", "aaaa"), "0,3");
+  ASSERT_EQUAL(search("a{2,}", "baaaa"), "1,5");
+  ASSERT_EQUAL(search("x*", "abc"), "0,0");
+  ASSERT_EQUAL(search("[0-9]+\\.[0-9]+", "pi is 3.14!"), "6,10");
+  ASSERT_EQUAL(search("\\d+", "abc 123 4"), "4,7");
+  ASSERT_EQUAL(search("\\w+", "  hello, world"), "2,7");
+  ASSERT_EQUAL(search("[^a-z ]+", "abc DEF"), "4,7");
+}
+
+TEST(test_leftmost_longest) {
+  // the leftmost match wins over an earlier-ending one
+  ASSERT_EQUAL(search("abcd|bc", "xabcd"), "1,5");
+  // and the longest at that start
+  ASSERT_EQUAL(search("a|ab|abc", "xabcx"), "1,4");
+  ASSERT_EQUAL(search("a.*z|q", "a..q..z"), "0,7");
+}
+
+TEST(test_lines) {
+  ASSERT_EQUAL(search("^b", "ab\nbc"), "3,4");
+  ASSERT_EQUAL(search("b$", "bc\nab\nc"), "4,5");
+  ASSERT_EQUAL(search("c$", "ab\nbc"), "4,5");
+  ASSERT_EQUAL(search("^$", "ab\n\ncd"), "3,3");
+  ASSERT_EQUAL(search("a.c", "a\nc abc"), "4,7");
+  ASSERT_EQUAL(search("b[^x]c", "b\nc b-c"), "4,7");
+  ASSERT_EQUAL(search("b\\nc", "ab\ncd"), "1,4");
+}
+
+TEST(test_utf8) {
+  string text = "caf\xC3\xA9 \xE4\xB8\xAD\xE6\x96\x87!";
+  ASSERT_EQUAL(search("f.", text, true), "2,5");
+  ASSERT_EQUAL(search("f.", text, false), "2,4");
+  ASSERT_EQUAL(search("\xC3\xA9+", text + "\xC3\xA9", true), "3,5");
+  ASSERT_EQUAL(search(" ...", text, true), "5,13");
+  ASSERT_EQUAL(search("[\xE6\x96\x87x]+", text, true), "9,12");
+  ASSERT_EQUAL(search("[^ a-z]+", text, true), "3,5");
+}
+
+TEST(test_errors) {
+  ASSERT_NOT_EQUAL(Regex("(ab", false).error(), "");
+  ASSERT_NOT_EQUAL(Regex("ab)", false).error(), "");
+  ASSERT_NOT_EQUAL(Regex("[ab", false).error(), "");
+  ASSERT_NOT_EQUAL(Regex("*a", false).error(), "");
+  ASSERT_NOT_EQUAL(Regex("a{3,2}", false).error(), "");
+  ASSERT_NOT_EQUAL(Regex("a{1001}", false).error(), "");
+  ASSERT_NOT_EQUAL(Regex("\\q", false).error(), "");
+  ASSERT_NOT_EQUAL(Regex("(a{1000}){1000}", false).error(), "");
+  ASSERT_NOT_EQUAL(Regex("[^\xC3\xA9]", true).error(), "");
+  ASSERT_EQUAL(Regex("a{2}[]x]\\.", false).error(), "");
+}
+
+TEST(test_matches_reference) {
+  srand(33);
+  for (int trial = 0; trial < 2000; ++trial) {
+    string pattern = random_pattern(3);
+    string text;
+    for (int i = rand() % 10; i > 0; --i) {
+      text.push_back('a' + rand() % 4);
+    }
+    ASSERT_EQUAL(search(pattern, text), reference_search(pattern, text));
+  }
+}
+
+TEST(test_dfa_cache_flush) {
+  // (a|b)*a(a|b){n} needs 2^n DFA states, more than are cached
+  Regex regex("a[ab]{12}c", false);
+  string text;
+  srand(4);
+  for (int i = 0; i < 200000; ++i) {
+    text.push_back("ab"[rand() % 2]);
+  }
+  size_t start = text.size() - 1000;
+  text.replace(start, 14, "abbbbbbbbbbbbc");
+  Regex::Match match;
+  ASSERT_TRUE(regex.search(text.data(), text.data() + text.size(), match));
+  ASSERT_EQUAL(match.start, static_cast<Position>(start));
+  ASSERT_EQUAL(match.end, static_cast<Position>(start + 14));
+}
+
+TEST(test_find_in_buffer) {
+  string text;
+  for (int i = 0; i < 20000; ++i) {
+    text += "line " + to_string(i) + (i % 977 == 0 ? " ERROR here\n" : "\n");
+  }
+  TextBuffer buffer;
+  buffer.insert(text.data(), text.size());
+  buffer.move_to_index(1000);
+  Regex regex("^line [0-9]+ ERROR", false);
+  Regex::Match match;
+  ASSERT_TRUE(regex.find_in(buffer, 1, buffer.size(), match));
+  size_t expected = text.find("line 977 ERROR");
+  ASSERT_EQUAL(match.start, static_cast<Position>(expected));
+  ASSERT_EQUAL(match.end, static_cast<Position>(expected + 14));
+  // a match may extend past the end of the range
+  ASSERT_TRUE(regex.find_in(buffer, expected, expected + 1, match));
+  ASSERT_EQUAL(match.end, static_cast<Position>(expected + 14));
+  ASSERT_FALSE(regex.find_in(buffer, expected + 1, expected + 5000, match));
+  // ^ only matches at the start of a line, even in the middle of a
+  // search
+  ASSERT_FALSE(regex.find_in(buffer, expected + 1, expected + 2, match));
+
+  ASSERT_TRUE(regex.rfind_in(buffer, 0, buffer.size(), match));
+  ASSERT_EQUAL(match.start,
+               static_cast<Position>(text.find("line 19540 ERROR")));
+  ASSERT_EQUAL(buffer.get_index(), 1000);
+}
+
+// Returns a MatchFinder that searches with regex.
+static MatchFinder finder(Regex &regex) {
+  return [&regex](const char *first, const char *last, Position from,
+                  Position &start, Position &end) {
+    Regex::Match match;
+    if (!regex.search(first, last, from, match)) {
+      return false;
+    }
+    start = match.start;
+    end = match.end;
+    return true;
+  };
+}
+
+TEST(test_replace_all) {
+  string text = "a1 b22\nc333 d\n";
+  TextBuffer buffer;
+  buffer.insert(text.data(), text.size());
+  Regex digits("[0-9]+", false);
+  ASSERT_EQUAL(replace_all(buffer, 0, finder(digits), "#"), 3);
+  ASSERT_EQUAL(buffer.stringify(), "a# b#\nc# d\n");
+
+  // ^ depends on the byte before where the search starts
+  Regex line_start("^[a-z]", false);
+  ASSERT_EQUAL(replace_all(buffer, 1, finder(line_start), "-"), 1);
+  ASSERT_EQUAL(buffer.stringify(), "a# b#\n-# d\n");
+
+  // empty matches step over a byte
+  Regex empty("x*", false);
+  TextBuffer small;
+  small.insert("axb", 3);
+  ASSERT_EQUAL(replace_all(small, 0, finder(empty), "."), 4);
+  ASSERT_EQUAL(small.stringify(), ".a..b.");
+}
+
+TEST_MAIN()
@@ -0,0 +1,235 @@
+#include "Search.hpp"
+#include "CharScan.hpp"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+using Position = TextBuffer::Position;
+
+Searcher::Searcher(const std::string &pattern_in)
+  : needle(pattern_in), critical(0), period(1), remembered(0) {
+  const std::size_t size = needle.size();
+  const unsigned char *n =
+    reinterpret_cast<const unsigned char *>(needle.data());
+  skip.fill(size);
+  if (size < 2) {
+    return;
+  }
+  for (std::size_t i = 0; i < size; ++i) {
+    skip[n[i]] = size - 1 - i;
+  }
+
+  // the critical factorization comes from the later of the two maximal
+  // suffixes
+  std::size_t forward_period, reverse_period;
+  std::size_t forward_start = maximal_suffix(false, forward_period);
+  std::size_t reverse_start = maximal_suffix(true, reverse_period);
+  if (reverse_start > forward_start) {
+    critical = reverse_start;
+    period = reverse_period;
+  } else {
+    critical = forward_start;
+    period = forward_period;
+  }
+  if (std::memcmp(n, n + period, critical) == 0) {
+    remembered = size - period;
+  } else {
+    // not periodic: any move up to the longer part is safe
+    remembered = 0;
+    period = std::max(critical, size - critical + 1);
+  }
+}
+
+const std::string & Searcher::pattern() const {
+  return needle;
+}
+
+const char * Searcher::find(const char *first, const char *last) const {
+  if (needle.empty()) {
+    return first;
+  } else if (needle.size() == 1) {
+    return find_char(first, last, needle[0]);
+  }
+  const std::size_t size = needle.size();
+  const char *n = needle.data();
+  std::size_t compared = 0; // bytes compared to verify candidates
+  for (const char *h = first;; ++h) {
+    h = find_pair(h, last, n[0], n[size - 1], size - 1);
+    if (h == last || std::memcmp(h + 1, n + 1, size - 2) == 0) {
+      return h;
+    }
+    compared += size;
+    if (compared > static_cast<std::size_t>(h - first) + FILTER_ALLOWANCE) {
+      // too many false candidates for the filter to pay off
+      return find_two_way(h + 1, last);
+    }
+  }
+}
+
+const char * Searcher::find_two_way(const char *first,
+                                    const char *last) const {
+  const std::size_t size = needle.size();
+  const char *n = needle.data();
+  std::size_t memory = 0; // bytes at the start known to match
+  for (const char *h = first; static_cast<std::size_t>(last - h) >= size;) {
+    std::size_t k = skip[static_cast<unsigned char>(h[size - 1])];
+    if (k != 0) {
+      h += std::max(k, memory);
+      memory = 0;
+      continue;
+    }
+    // compare the right part, then the left part
+    for (k = std::max(critical, memory); k < size && n[k] == h[k]; ++k);
+    if (k < size) {
+      h += k - critical + 1;
+      memory = 0;
+      continue;
+    }
+    for (k = critical; k > memory && n[k - 1] == h[k - 1]; --k);
+    if (k <= memory) {
+      return h;
+    }
+    h += period;
+    memory = remembered;
+  }
+  return last;
+}
+
+std::size_t Searcher::maximal_suffix(bool reversed,
+                                     std::size_t &suffix_period) const {
+  const unsigned char *n =
+    reinterpret_cast<const unsigned char *>(needle.data());
+  const std::size_t size = needle.size();
+  // candidate suffix starts after start, and is compared against the
+  // suffix starting after other, k bytes in
+  std::size_t start = 0, other = 1, k = 1, p = 1;
+  while (other + k <= size) {
+    unsigned char a = n[start + k - 1], b = n[other + k - 1];
+    if (a == b) {
+      if (k == p) {
+        other += p;
+        k = 1;
+      } else {
+        ++k;
+      }
+    } else if (reversed ? a < b : a > b) {
+      other += k;
+      k = 1;
+      p = other - start;
+    } else {
+      start = other++;
+      k = p = 1;
+    }
+  }
+  suffix_period = p;
+  return start;
+}
+
+namespace {
+
+// Searches the stream of blocks produced by visit for the searcher's
+// pattern, keeping the end of each block to find matches that span two
+// blocks. Returns the offset of the first match in the stream, or -1.
+Position search_blocks(const Searcher &searcher,
+                       const std::function<void(
+                         const TextBuffer::BlockVisitor &)> &visit) {
+  const Position size = searcher.pattern().size();
+  std::string window; // the end of the previous block, then this one
+  Position window_start = 0;
+  Position found = -1;
+  visit([&](const char *block, Position count) {
+    window.append(block, count);
+    const char *window_end = window.data() + window.size();
+    const char *match = searcher.find(window.data(), window_end);
+    if (match != window_end) {
+      found = window_start + (match - window.data());
+      return false;
+    }
+    // keep the bytes that may begin a match ending in the next block
+    Position keep = std::min<Position>(window.size(), size - 1);
+    window_start += window.size() - keep;
+    window.erase(0, window.size() - keep);
+    return true;
+  });
+  return found;
+}
+
+} // namespace
+
+Position find_in(const TextBuffer &text, const Searcher &searcher,
+                 Position first, Position last) {
+  const Position size = searcher.pattern().size();
+  if (size == 0) {
+    return first < last ? first : -1;
+  }
+  // matches starting before last may extend past it
+  Position end = std::min(text.size(), last + size - 1);
+  Position found = search_blocks(searcher, [&](
+    const TextBuffer::BlockVisitor &visitor) {
+    text.visit(first, end, visitor);
+  });
+  return found == -1 ? -1 : first + found;
+}
+
+Position rfind_in(const TextBuffer &text, const Searcher &reverse_searcher,
+                  Position first, Position last) {
+  const Position size = reverse_searcher.pattern().size();
+  if (size == 0) {
+    return first < last ? last - 1 : -1;
+  }
+  // the reversed pattern is found in the reversed text, where the first
+  // match is the one that ends last
+  Position end = std::min(text.size(), last + size - 1);
+  Position found = search_blocks(reverse_searcher, [&](
+    const TextBuffer::BlockVisitor &visitor) {
+    text.visit_reverse(first, end, visitor);
+  });
+  return found == -1 ? -1 : end - found - size;
+}
+
+Position replace_all(TextBuffer &text, Position first,
+                     const MatchFinder &find_match,
+                     const std::string &replacement) {
+  // keep the byte before first, which may decide whether a match can
+  // start there
+  Position context = std::max<Position>(0, first - 1);
+  std::string rest;
+  rest.reserve(text.size() - context);
+  text.visit(context, text.size(), [&](const char *block, Position count) {
+    rest.append(block, count);
+    return true;
+  });
+  const char *data = rest.data();
+  const Position size = rest.size();
+
+  // replace each match in place, in a batch so observers see one edit;
+  // bytes between matches are left alone
+  Position replaced = 0;
+  Position shift = context; // from offsets in rest to indices in text
+  Position start, end;
+  text.begin_batch();
+  for (Position from = first - context;
+       from <= size && find_match(data, data + size, from, start, end);
+       from = (end > start ? end : end + 1)) {
+    text.move_to_index(start + shift);
+    text.erase(end - start);
+    text.insert(replacement.data(), replacement.size());
+    shift += replacement.size() - (end - start);
+    ++replaced;
+  }
+  text.end_batch();
+  return replaced;
+}
+
+MatchFinder substring_finder(const Searcher &searcher) {
+  return [&searcher](const char *first, const char *last, Position from,
+                     Position &start, Position &end) {
+    const char *match = searcher.find(first + from, last);
+    if (match == last) {
+      return false;
+    }
+    start = match - first;
+    end = start + searcher.pattern().size();
+    return true;
+  };
+}
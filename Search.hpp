@@ -0,0 +1,113 @@
+#ifndef SEARCH_HPP
+#define SEARCH_HPP
+/* Search.hpp
+ *
+ * Substring search over contiguous text and over the contents of a
+ * TextBuffer. Candidate matches are first found by their first and
+ * last bytes with a vectorized scan (see CharScan.hpp), which is fast
+ * on ordinary text. If a text produces too many false candidates, the
+ * search switches to the Two-Way algorithm, which runs in linear time
+ * in the worst case and, like Boyer-Moore-Horspool, skips ahead on
+ * bytes that do not occur in the pattern.
+ *
+ * EECS 280 List/Editor Project
+ */
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include "TextBuffer.hpp"
+
+class Searcher {
+public:
+  // Number of bytes that may be compared to rule out false candidates,
+  // beyond one per byte of text scanned, before switching to Two-Way.
+  static constexpr std::size_t FILTER_ALLOWANCE = 4096;
+
+  //EFFECTS: Prepares to search for the given pattern.
+  explicit Searcher(const std::string &pattern_in);
+
+  //EFFECTS: Returns the pattern being searched for.
+  const std::string & pattern() const;
+
+  //REQUIRES: [first, last) is a valid range
+  //EFFECTS:  Returns a pointer to the start of the first occurrence of
+  //          the pattern in the range, or last if there is none.
+  const char * find(const char *first, const char *last) const;
+
+private:
+  std::string needle;
+
+  // Horspool's bad-character shift, as used by Two-Way: the distance to
+  // move the pattern when a byte is aligned with its last byte, which
+  // is the distance from the last occurrence of the byte in the pattern
+  // to its end (0 if it is the last byte of the pattern).
+  std::array<std::size_t, 256> skip;
+
+  // Two-Way factorization: the pattern is split into needle[0, critical)
+  // and needle[critical, size), and moves by period after a match of
+  // the right part. If the pattern is periodic, the first
+  // remembered bytes after such a move are known to match.
+  std::size_t critical;
+  std::size_t period;
+  std::size_t remembered;
+
+  //EFFECTS: Two-Way search, for patterns of at least 2 bytes.
+  const char * find_two_way(const char *first, const char *last) const;
+
+  //REQUIRES: the pattern is not empty
+  //EFFECTS:  Returns the start of the maximal suffix of the pattern,
+  //          with respect to the byte order (if reversed is false) or
+  //          its reverse, and sets suffix_period to that suffix's period.
+  std::size_t maximal_suffix(bool reversed,
+                             std::size_t &suffix_period) const;
+};
+
+//REQUIRES: 0 <= first <= last <= text.size()
+//EFFECTS:  Returns the index of the first occurrence of the searcher's
+//          pattern in text that starts in [first, last), or -1 if there
+//          is none. The cursor does not move.
+TextBuffer::Position find_in(const TextBuffer &text,
+                             const Searcher &searcher,
+                             TextBuffer::Position first,
+                             TextBuffer::Position last);
+
+//REQUIRES: 0 <= first <= last <= text.size(), and reverse_searcher
+//          searches for the reverse of the pattern
+//EFFECTS:  Returns the index of the last occurrence of the pattern in
+//          text that starts in [first, last), or -1 if there is none.
+//          The cursor does not move.
+TextBuffer::Position rfind_in(const TextBuffer &text,
+                              const Searcher &reverse_searcher,
+                              TextBuffer::Position first,
+                              TextBuffer::Position last);
+
+// Function that finds the first match in the text [first, last) that
+// starts at or after first + from, setting start and end to the offsets
+// of its bytes from first. Returns whether there is one.
+using MatchFinder = std::function<bool(const char *first, const char *last,
+                                       TextBuffer::Position from,
+                                       TextBuffer::Position &start,
+                                       TextBuffer::Position &end)>;
+
+//REQUIRES: 0 <= first <= text.size()
+//MODIFIES: text
+//EFFECTS:  Replaces each match found by find_match that starts at or
+//          after first with replacement, searching for the next match
+//          after the end of the previous one (or one byte further, after
+//          an empty match). The text is copied out and searched in one
+//          pass, and each match is replaced with one erase() and one
+//          insert() as the cursor moves forward, in a batch so observers
+//          see a single edit. The cursor is left after the last
+//          replacement if there was one. Returns the number of matches
+//          replaced.
+TextBuffer::Position replace_all(TextBuffer &text, TextBuffer::Position first,
+                                 const MatchFinder &find_match,
+                                 const std::string &replacement);
+
+//EFFECTS: Returns a MatchFinder for the searcher's pattern, which must
+//         not be empty. The searcher must outlive it.
+MatchFinder substring_finder(const Searcher &searcher);
+
+#endif // SEARCH_HPP
@@ -0,0 +1,182 @@
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "Search.hpp"
+#include "unit_test_framework.hpp"
+
+using namespace std;
+
+// Returns a random string of the given length over the first
+// alphabet_size lowercase letters.
+static string random_string(size_t length, int alphabet_size) {
+  string text;
+  for (size_t i = 0; i < length; ++i) {
+    text.push_back('a' + rand() % alphabet_size);
+  }
+  return text;
+}
+
+// Returns the offset of the searcher's first match in text, or npos.
+static size_t find_offset(const Searcher &searcher, const string &text) {
+  const char *first = text.data(), *last = first + text.size();
+  const char *found = searcher.find(first, last);
+  return found == last ? string::npos : found - first;
+}
+
+TEST(test_empty_and_single_byte) {
+  string text = "hello world";
+  ASSERT_EQUAL(find_offset(Searcher(""), text), 0u);
+  ASSERT_EQUAL(find_offset(Searcher("o"), text), 4u);
+  ASSERT_EQUAL(find_offset(Searcher("z"), text), string::npos);
+  ASSERT_EQUAL(find_offset(Searcher("hello world!"), text), string::npos);
+}
+
+TEST(test_matches_string_find) {
+  // small alphabets produce periodic patterns and many partial matches,
+  // exercising both Horspool and Two-Way
+  srand(280);
+  for (int trial = 0; trial < 20000; ++trial) {
+    int alphabet_size = trial % 5 == 4 ? 26 : 1 + rand() % 4;
+    string text = random_string(rand() % 200, alphabet_size);
+    string pattern = random_string(1 + rand() % 24, alphabet_size);
+    if (trial % 3 == 0 && text.size() > pattern.size()) {
+      // plant a match
+      text.replace(rand() % (text.size() - pattern.size()),
+                   pattern.size(), pattern);
+    }
+    ASSERT_EQUAL(find_offset(Searcher(pattern), text), text.find(pattern));
+  }
+}
+
+TEST(test_two_way_fallback) {
+  // texts long enough, and patterns with common enough first and last
+  // bytes, for the search to give up on filtering candidates
+  srand(281);
+  for (int trial = 0; trial < 300; ++trial) {
+    int alphabet_size = 1 + rand() % 3;
+    string text = random_string(20000 + rand() % 1000, alphabet_size);
+    string pattern = random_string(2 + rand() % 40, alphabet_size);
+    if (trial % 2 == 0) {
+      // plant a match near the end
+      text.replace(text.size() - pattern.size() - rand() % 100,
+                   pattern.size(), pattern);
+    }
+    ASSERT_EQUAL(find_offset(Searcher(pattern), text), text.find(pattern));
+  }
+}
+
+TEST(test_high_bytes) {
+  string text = "caf\xC3\xA9 \xFF\xFE\xC3\xA9\xC3\xA9 end";
+  ASSERT_EQUAL(find_offset(Searcher("\xC3\xA9\xC3\xA9"), text), 8u);
+  ASSERT_EQUAL(find_offset(Searcher("\xFF\xFE\xC3\xA9\xC3\xA9 end"), text),
+               6u);
+}
+
+TEST(test_periodic_worst_case) {
+  string text(100000, 'a');
+  string pattern = string(40, 'a') + "ba";
+  ASSERT_EQUAL(find_offset(Searcher(pattern), text), string::npos);
+  text += "ba";
+  ASSERT_EQUAL(find_offset(Searcher(pattern), text), text.size() - 42);
+}
+
+TEST(test_find_in_buffer) {
+  // long enough to span several blocks, with matches across block ends
+  srand(7);
+  string text = random_string(3 * TextBuffer::BLOCK_SIZE + 100, 3);
+  TextBuffer buffer;
+  buffer.insert(text.data(), text.size());
+  buffer.move_to_index(text.size() / 2);
+  for (int trial = 0; trial < 200; ++trial) {
+    string pattern = random_string(1 + rand() % 12, 3);
+    Searcher searcher(pattern);
+    TextBuffer::Position first = rand() % text.size();
+    TextBuffer::Position last = first + rand() % (text.size() - first);
+    size_t expected = text.find(pattern, first);
+    TextBuffer::Position found = find_in(buffer, searcher, first, last);
+    if (expected == string::npos
+        || static_cast<TextBuffer::Position>(expected) >= last) {
+      ASSERT_EQUAL(found, -1);
+    } else {
+      ASSERT_EQUAL(found, static_cast<TextBuffer::Position>(expected));
+    }
+  }
+  ASSERT_EQUAL(buffer.get_index(),
+               static_cast<TextBuffer::Position>(text.size() / 2));
+}
+
+TEST(test_rfind_in_buffer) {
+  srand(8);
+  string text = random_string(3 * TextBuffer::BLOCK_SIZE + 100, 3);
+  TextBuffer buffer;
+  buffer.insert(text.data(), text.size());
+  buffer.move_to_index(text.size() / 3);
+  for (int trial = 0; trial < 200; ++trial) {
+    string pattern = random_string(1 + rand() % 12, 3);
+    Searcher reverse_searcher(string(pattern.rbegin(), pattern.rend()));
+    TextBuffer::Position first = rand() % text.size();
+    TextBuffer::Position last = first + rand() % (text.size() - first);
+    // the last match starting before last
+    size_t expected = last == 0 ? string::npos : text.rfind(pattern, last - 1);
+    TextBuffer::Position found =
+      rfind_in(buffer, reverse_searcher, first, last);
+    if (expected == string::npos
+        || static_cast<TextBuffer::Position>(expected) < first) {
+      ASSERT_EQUAL(found, -1);
+    } else {
+      ASSERT_EQUAL(found, static_cast<TextBuffer::Position>(expected));
+    }
+  }
+  ASSERT_EQUAL(buffer.get_index(),
+               static_cast<TextBuffer::Position>(text.size() / 3));
+}
+
+TEST(test_find_in_rows) {
+  TextBuffer buffer;
+  string text = "first row\nsecond row\nthird\n";
+  buffer.insert(text.data(), text.size());
+  Searcher searcher("row\nthi");
+  ASSERT_EQUAL(find_in(buffer, searcher, 0, buffer.size()), 17);
+  ASSERT_EQUAL(find_in(buffer, searcher, 0, 17), -1);
+  ASSERT_EQUAL(find_in(buffer, searcher, 18, buffer.size()), -1);
+  Searcher reverse_searcher("w");
+  ASSERT_EQUAL(rfind_in(buffer, reverse_searcher, 0, buffer.size()), 19);
+  ASSERT_EQUAL(rfind_in(buffer, reverse_searcher, 0, 19), 8);
+  ASSERT_EQUAL(rfind_in(buffer, reverse_searcher, 9, 19), -1);
+}
+
+TEST(test_replace_all) {
+  string text = "one fish two fish\nred fish blue fish";
+  TextBuffer buffer;
+  buffer.insert(text.data(), text.size());
+  vector<TextBuffer::Edit> edits;
+  buffer.subscribe([&](const TextBuffer::Edit &edit) {
+    edits.push_back(edit);
+  });
+  Searcher searcher("fish");
+  ASSERT_EQUAL(replace_all(buffer, 1, substring_finder(searcher), "cat"),
+               4);
+  ASSERT_EQUAL(buffer.stringify(), "one cat two cat\nred cat blue cat");
+  ASSERT_EQUAL(edits.size(), 1u); // from the first match to the last
+  ASSERT_EQUAL(edits[0].index, 4);
+  ASSERT_EQUAL(edits[0].removed, 32);
+  ASSERT_EQUAL(edits[0].inserted, "cat two cat\nred cat blue cat");
+  ASSERT_EQUAL(buffer.get_index(), buffer.size());
+  ASSERT_EQUAL(buffer.row_count(), 2);
+
+  // only matches starting at or after first, not overlapping
+  buffer.move_to_index(0);
+  ASSERT_EQUAL(replace_all(buffer, 5, substring_finder(Searcher("cat")),
+                           "c"), 3);
+  ASSERT_EQUAL(buffer.stringify(), "one cat two c\nred c blue c");
+  TextBuffer runs;
+  runs.insert("aaaaa", 5);
+  ASSERT_EQUAL(replace_all(runs, 0, substring_finder(Searcher("aa")),
+                           "b\n"), 2);
+  ASSERT_EQUAL(runs.stringify(), "b\nb\na");
+  ASSERT_EQUAL(runs.row_count(), 3);
+  ASSERT_EQUAL(replace_all(runs, 0, substring_finder(Searcher("x")), ""),
+               0);
+}
+
+TEST_MAIN()
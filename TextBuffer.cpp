@@ -1,4 +1,37 @@
 #include "TextBuffer.hpp"
+#include "CharScan.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <iterator>
+
+// Returns whether c is a UTF-8 continuation byte (10xxxxxx).
+static bool is_continuation(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+// Returns whether c is part of a word, i.e. is not whitespace.
+static bool is_word(char c) {
+    return c != ' ' && c != '\t' && c != '\n' && c != '\r'
+        && c != '\v' && c != '\f';
+}
+
+// Returns the change in the number of words when the characters in
+// [first, last) are placed between two characters, where before and
+// after are whether those characters are part of words.
+static TextBuffer::Position word_delta(bool before, const char *first,
+                                       const char *last, bool after) {
+    TextBuffer::Position words_with = before;
+    bool previous = before;
+    for (const char *p = first; p != last; ++p) {
+        bool current = is_word(*p);
+        words_with += current && !previous; // a word starts here
+        previous = current;
+    }
+    words_with += after && !previous;
+    TextBuffer::Position words_without = before + (after && !before);
+    return words_with - words_without;
+}
 
 // Constructor
 TextBuffer::TextBuffer() {
@@ -6,6 +39,25 @@ TextBuffer::TextBuffer() {
     row = 1;
     column = 0;
     index = 0;
+    column_mode = BYTES;
+    next_observer_id = 0;
+    batch_depth = 0;
+    batch_edited = false;
+    rebuild_index();
+}
+
+void TextBuffer::set_column_mode(ColumnMode mode) {
+    column_mode = mode;
+    // move back to the first byte of the current character
+    while (!is_boundary(cursor)) {
+        --cursor;
+        --index;
+    }
+    rebuild_index();
+}
+
+TextBuffer::ColumnMode TextBuffer::get_column_mode() const {
+    return column_mode;
 }
 
 bool TextBuffer::forward() {
@@ -20,7 +72,10 @@ bool TextBuffer::forward() {
     if (current_char == '\n') {
         ++row;
         column = 0;
+        ++current_row;
+        row_start_index = index;
     } else {
+        skip_to_boundary();
         ++column;
     }
     
@@ -34,10 +89,17 @@ bool TextBuffer::backward() {
     
     --cursor;
     --index;
+    while (!is_boundary(cursor)) { // back to the start of the character
+        --cursor;
+        --index;
+    }
     
     if (*cursor == '\n') {
+        // the newline is at the end of the previous row
         --row;
-        column = compute_column();
+        --current_row;
+        row_start_index = index - current_row->bytes;
+        column = current_row->columns;
     } else {
         --column;
     }
@@ -46,16 +108,104 @@ bool TextBuffer::backward() {
 }
 
 void TextBuffer::insert(char c) {
-    data.insert(cursor, c);
+    insert(&c, 1);
+}
+
+void TextBuffer::insert(const char *chars, Position count) {
+    if (count == 0) {
+        return;
+    }
+    Position edit_index = index;
+    Position edit_row = row;
+    const char *last = chars + count;
+    words += word_delta(cursor != data.begin() && is_word(*std::prev(cursor)),
+                        chars, last,
+                        cursor != data.end() && is_word(*cursor));
+    Iterator first_inserted = data.insert(cursor, chars, last);
     // cursor remains pointing to the same element (after insertion)
-    
-    if (c == '\n') {
-        ++row;
-        column = 0;
+    if (column == 0) {
+        current_row->start = first_inserted;
+    }
+
+    const char *newline = find_char(chars, last, '\n');
+    if (newline == last) {
+        Position added = count_columns(chars, last, column == 0);
+        current_row->bytes += count;
+        set_row_columns(current_row->columns + added);
+        column += added;
+        characters += added;
     } else {
-        ++column;
+        // the current row ends at the first inserted newline
+        Position bytes_before = index - row_start_index;
+        Position bytes_after = current_row->bytes - bytes_before;
+        Position columns_after = current_row->columns - column;
+        current_row->bytes = bytes_before + (newline - chars);
+        set_row_columns(column + count_columns(chars, newline, column == 0));
+        characters += current_row->columns - column + 1;
+
+        // each further newline starts a new row
+        Iterator row_start = std::next(first_inserted, newline - chars + 1);
+        for (const char *row_first = newline + 1; ; row_first = newline + 1) {
+            newline = find_char(row_first, last, '\n');
+            Row entry = { row_start, newline - row_first,
+                          count_columns(row_first, newline, true) };
+            characters += entry.columns;
+            ++row;
+            if (newline == last) {
+                // the last row continues with the rest of the old row
+                column = entry.columns;
+                row_start_index = index + (row_first - chars);
+                entry.bytes += bytes_after;
+                entry.columns += columns_after;
+                current_row = rows.insert(std::next(current_row), entry);
+                count_row_length(entry.columns, 1);
+                break;
+            }
+            ++characters; // the newline
+            current_row = rows.insert(std::next(current_row), entry);
+            count_row_length(entry.columns, 1);
+            std::advance(row_start, newline - row_first + 1);
+        }
     }
-    ++index;
+    index += count;
+    join_continuation_bytes();
+    notify(edit_index, edit_row, 0, chars, count);
+}
+
+void TextBuffer::append(const char *chars, Position count) {
+    if (count == 0) {
+        return;
+    }
+    // insert at the end, then put the cursor back; list iterators,
+    // including those in the row index, stay valid
+    Iterator old_cursor = cursor;
+    RowList::iterator old_row = current_row;
+    Position old_index = index;
+    Position old_row_number = row;
+    Position old_column = column;
+    Position old_row_start_index = row_start_index;
+    bool was_at_end = (cursor == data.end());
+    Iterator old_last = data.empty() ? data.end() : std::prev(data.end());
+
+    cursor = data.end();
+    current_row = std::prev(rows.end());
+    index = size();
+    row = row_count();
+    column = current_row->columns;
+    row_start_index = index - current_row->bytes;
+    insert(chars, count);
+
+    cursor = old_cursor;
+    if (was_at_end) {
+        cursor = (old_last == data.end() ? data.begin() : std::next(old_last));
+    }
+    current_row = old_row;
+    index = old_index;
+    row = old_row_number;
+    column = old_column;
+    row_start_index = old_row_start_index;
+    // the appended bytes may continue the character before the cursor
+    skip_to_boundary();
 }
 
 bool TextBuffer::remove() {
@@ -63,110 +213,262 @@ bool TextBuffer::remove() {
         return false;
     }
     
-    char removed_char = *cursor;
-    cursor = data.erase(cursor);
-    
-    if (removed_char == '\n') {
-        // Removing a newline merges the next row into current row
-        // We stay at the same row, but need to recalculate column
-        column = compute_column();
+    std::string removed = character_at_cursor();
+    Iterator after = std::next(cursor, removed.size());
+    words -= word_delta(cursor != data.begin() && is_word(*std::prev(cursor)),
+                        removed.data(), removed.data() + removed.size(),
+                        after != data.end() && is_word(*after));
+    bool at_row_start = (cursor == current_row->start);
+    cursor = data.erase(cursor, after);
+    --characters;
+    if (at_row_start) {
+        // the row now starts with what followed the removed character
+        current_row->start = cursor;
     }
-    // For non-newline characters, row and column stay the same
-    // (cursor now points to what was the next character)
     
-    // Update index to match cursor position
-    if (cursor == data.end()) {
-        index = static_cast<int>(data.size());
+    if (removed == "\n") {
+        // Removing a newline merges the next row into current row
+        // We stay at the same row and column
+        auto next_row = std::next(current_row);
+        current_row->bytes += next_row->bytes;
+        count_row_length(next_row->columns, -1);
+        set_row_columns(current_row->columns + next_row->columns);
+        rows.erase(next_row);
+        join_continuation_bytes();
+    } else {
+        // For other characters, row and column stay the same
+        // (cursor now points to what was the next character)
+        current_row->bytes -= removed.size();
+        set_row_columns(current_row->columns - 1);
     }
+    notify(index, row, removed.size(), nullptr, 0);
     
     return true;
 }
 
-void TextBuffer::move_to_row_start() {
-    // Move backward to find the newline that starts this row
-    while (cursor != data.begin()) {
-        auto prev = cursor;
-        --prev;
-        if (*prev == '\n') {
-            break;
+void TextBuffer::erase(Position count) {
+    std::string removed;
+    cut(count, removed);
+}
+
+void TextBuffer::cut(Position count, std::string &destination) {
+    if (count == 0) {
+        return;
+    }
+    Iterator after = std::next(cursor, count);
+    std::size_t offset = destination.size();
+    destination.append(cursor, after);
+    const char *first = destination.data() + offset;
+    const char *last = first + count;
+    words -= word_delta(cursor != data.begin() && is_word(*std::prev(cursor)),
+                        first, last, after != data.end() && is_word(*after));
+    bool at_row_start = (cursor == current_row->start);
+    cursor = data.erase(cursor, after);
+    if (at_row_start) {
+        current_row->start = cursor;
+    }
+
+    const char *newline = find_char(first, last, '\n');
+    if (newline == last) {
+        Position columns = count_columns(first, last, column == 0);
+        current_row->bytes -= count;
+        set_row_columns(current_row->columns - columns);
+        characters -= columns;
+    } else {
+        // the current row continues with the rest of the row that held
+        // the last removed byte, and the rows in between are gone
+        Position bytes_before = index - row_start_index;
+        characters -= count_columns(first, newline, column == 0);
+        auto next_row = std::next(current_row);
+        const char *row_first = newline + 1;
+        while ((newline = find_char(row_first, last, '\n')) != last) {
+            characters -= next_row->columns + 1;
+            count_row_length(next_row->columns, -1);
+            next_row = rows.erase(next_row);
+            row_first = newline + 1;
         }
-        --cursor;
-        --index;
+        Position columns = count_columns(row_first, last, true);
+        characters -= columns + 1;
+        current_row->bytes = bytes_before + next_row->bytes
+            - (last - row_first);
+        count_row_length(next_row->columns, -1);
+        set_row_columns(column + next_row->columns - columns);
+        rows.erase(next_row);
     }
+    join_continuation_bytes();
+    notify(index, row, count, nullptr, 0);
+}
+
+void TextBuffer::move_to_row_start() {
+    cursor = current_row->start;
+    index = row_start_index;
     column = 0;  // At start of row
 }
 
 void TextBuffer::move_to_row_end() {
-    // Move forward to find the newline that ends this row
-    while (cursor != data.end() && *cursor != '\n') {
-        ++cursor;
-        ++index;
-    }
-    column = compute_column();  // Recalculate column
+    // the row ends just before the start of the next one
+    auto next_row = std::next(current_row);
+    cursor = (next_row == rows.end() ? data.end()
+              : std::prev(next_row->start));
+    index = row_start_index + current_row->bytes;
+    column = current_row->columns;
 }
 
-void TextBuffer::move_to_column(int new_column) {
+void TextBuffer::move_to_column(Position new_column) {
     // First move to row start
     move_to_row_start();
     
     // Then move forward to the desired column
-    int current_col = 0;
-    while (cursor != data.end() && *cursor != '\n' && current_col < new_column) {
-        ++cursor;
-        ++index;
-        ++current_col;
+    advance_to_column(new_column);
+}
+
+void TextBuffer::move_to_index(Position new_index) {
+    assert(0 <= new_index && new_index <= size());
+    if (new_index < index
+        || new_index > row_start_index + current_row->bytes) {
+        locate_row(new_index, current_row, row_start_index, row);
+        move_to_row_start();
+    }
+    // step over whole characters that end at or before the new index
+    while (index < new_index) {
+        Iterator next = std::next(cursor);
+        Position next_index = index + 1;
+        while (!is_boundary(next)) {
+            ++next;
+            ++next_index;
+        }
+        if (next_index > new_index) {
+            break;
+        }
+        cursor = next;
+        index = next_index;
+        ++column;
     }
-    
-    column = current_col;
 }
 
-bool TextBuffer::up() {
-    if (row == 1) {
-        return false;
+void TextBuffer::move_to_row(Position row_number, Position new_column) {
+    assert(1 <= row_number && row_number <= row_count());
+    // walk the index from whichever of the first, current or last row
+    // is nearest
+    if (row_number - 1 < std::abs(row_number - row)) {
+        current_row = rows.begin();
+        row_start_index = 0;
+        row = 1;
+    } else if (row_count() - row_number < std::abs(row_number - row)) {
+        current_row = std::prev(rows.end());
+        row_start_index = size() - current_row->bytes;
+        row = row_count();
     }
-    
-    int target_column = column;
-    
-    // Move to start of current row
-    move_to_row_start();
-    
-    // If we're at the beginning, can't go up
-    if (cursor == data.begin()) {
+    while (row < row_number) {
+        row_start_index += current_row->bytes + 1;
+        ++current_row;
+        ++row;
+    }
+    while (row > row_number) {
+        --current_row;
+        --row;
+        row_start_index -= current_row->bytes + 1;
+    }
+    move_to_column(new_column);
+}
+
+bool TextBuffer::skip_forward_while(const ByteClass &byte_class) {
+    Iterator position = cursor;
+    Position new_index = index;
+    Position new_column = column;
+    bool codepoints = (column_mode == CODEPOINTS);
+    while (position != data.end()) {
+        char c = *position;
+        if (codepoints && is_continuation(c)
+            && new_index != row_start_index) {
+            // the rest of a character already skipped
+            ++position;
+            ++new_index;
+            continue;
+        }
+        if (!byte_class[static_cast<unsigned char>(c)]) {
+            break;
+        }
+        ++position;
+        ++new_index;
+        if (c == '\n') {
+            ++row;
+            ++current_row;
+            row_start_index = new_index;
+            new_column = 0;
+        } else {
+            ++new_column;
+        }
+    }
+    bool moved = (position != cursor);
+    cursor = position;
+    index = new_index;
+    column = new_column;
+    return moved;
+}
+
+bool TextBuffer::skip_backward_while(const ByteClass &byte_class) {
+    Iterator position = cursor;
+    Position new_index = index;
+    Position new_column = column;
+    while (position != data.begin()) {
+        // find the first byte of the character before the position
+        Iterator previous = std::prev(position);
+        Position previous_index = new_index - 1;
+        while (!is_boundary(previous)) {
+            --previous;
+            --previous_index;
+        }
+        if (!byte_class[static_cast<unsigned char>(*previous)]) {
+            break;
+        }
+        position = previous;
+        new_index = previous_index;
+        if (*position == '\n') {
+            // the newline is at the end of the previous row
+            --row;
+            --current_row;
+            row_start_index = new_index - current_row->bytes;
+            new_column = current_row->columns;
+        } else {
+            --new_column;
+        }
+    }
+    bool moved = (position != cursor);
+    cursor = position;
+    index = new_index;
+    column = new_column;
+    return moved;
+}
+
+bool TextBuffer::up() {
+    if (current_row == rows.begin()) {
         return false;
     }
     
-    // Move one position back (to the newline ending the previous row)
-    --cursor;
-    --index;
-    
-    // Now we're at the newline, which is the end of the previous row
-    // Update row (we're now at the end of the previous row)
+    Position target_column = column;
     --row;
+    --current_row;
+    row_start_index -= current_row->bytes + 1; // including the newline
     
-    // Move to the start of this (previous) row, then to target column
+    // Move to the start of the previous row, then to target column
     move_to_column(target_column);
     
     return true;
 }
 
 bool TextBuffer::down() {
-    // Move to end of current row
-    move_to_row_end();
-    
-    // If we're at the end of the buffer, can't go down
-    if (cursor == data.end()) {
+    auto next_row = std::next(current_row);
+    if (next_row == rows.end()) {
         return false;
     }
     
-    int target_column = column;
-    
-    // Skip the newline
-    ++cursor;
-    ++index;
+    Position target_column = column;
     ++row;
-    column = 0;
+    row_start_index += current_row->bytes + 1; // including the newline
+    current_row = next_row;
     
-    // Move to the target column in the next row
+    // Move to the start of the next row, then to target column
     move_to_column(target_column);
     
     return true;
@@ -180,42 +482,419 @@ char TextBuffer::data_at_cursor() const {
     return *cursor;
 }
 
-int TextBuffer::get_row() const {
+std::string TextBuffer::character_at_cursor() const {
+    std::string character(1, *cursor);
+    if (*cursor != '\n') {
+        for (auto it = std::next(cursor); !is_boundary(it); ++it) {
+            character.push_back(*it);
+        }
+    }
+    return character;
+}
+
+TextBuffer::Position TextBuffer::get_row() const {
+    return row;
+}
+
+TextBuffer::Position TextBuffer::get_column() const {
+    return column;
+}
+
+TextBuffer::Position TextBuffer::get_index() const {
+    return index;
+}
+
+TextBuffer::Position TextBuffer::size() const {
+    return static_cast<Position>(data.size());
+}
+
+TextBuffer::Position TextBuffer::row_count() const {
+    return static_cast<Position>(rows.size());
+}
+
+TextBuffer::Position TextBuffer::row_length(Position row_number) const {
+    assert(1 <= row_number && row_number <= row_count());
+    // walk from whichever of the first, current or last row is nearest
+    Position from_current = row_number - row;
+    RowList::const_iterator it = current_row;
+    if (row_number - 1 < std::abs(from_current)) {
+        it = std::next(rows.begin(), row_number - 1);
+    } else if (row_count() - row_number < std::abs(from_current)) {
+        it = std::prev(rows.end(), row_count() - row_number + 1);
+    } else {
+        std::advance(it, from_current);
+    }
+    return it->columns;
+}
+
+TextBuffer::Reader TextBuffer::reader_at_row(Position row_number) const {
+    assert(1 <= row_number && row_number <= row_count());
+    // walk from whichever of the first, current or last row is nearest
+    Reader reader;
+    reader.buffer = this;
+    reader.current_row = current_row;
+    reader.row_start_index = row_start_index;
+    reader.row = row;
+    if (row_number - 1 < std::abs(row_number - row)) {
+        reader.current_row = rows.begin();
+        reader.row_start_index = 0;
+        reader.row = 1;
+    } else if (row_count() - row_number < std::abs(row_number - row)) {
+        reader.current_row = std::prev(rows.end());
+        reader.row_start_index = size() - reader.current_row->bytes;
+        reader.row = row_count();
+    }
+    while (reader.row < row_number) {
+        reader.row_start_index += reader.current_row->bytes + 1;
+        ++reader.current_row;
+        ++reader.row;
+    }
+    while (reader.row > row_number) {
+        --reader.current_row;
+        --reader.row;
+        reader.row_start_index -= reader.current_row->bytes + 1;
+    }
+    reader.position = reader.current_row->start;
+    reader.column = 0;
+    reader.index = reader.row_start_index;
+    return reader;
+}
+
+bool TextBuffer::Reader::is_at_end() const {
+    return position == buffer->data.end();
+}
+
+char TextBuffer::Reader::data() const {
+    return *position;
+}
+
+std::string TextBuffer::Reader::character() const {
+    std::string character(1, *position);
+    if (*position != '\n') {
+        for (auto it = std::next(position); !buffer->is_boundary(it); ++it) {
+            character.push_back(*it);
+        }
+    }
+    return character;
+}
+
+TextBuffer::Position TextBuffer::Reader::get_row() const {
     return row;
 }
 
-int TextBuffer::get_column() const {
+TextBuffer::Position TextBuffer::Reader::get_column() const {
     return column;
 }
 
-int TextBuffer::get_index() const {
+TextBuffer::Position TextBuffer::Reader::get_index() const {
     return index;
 }
 
-int TextBuffer::size() const {
-    return data.size();
+bool TextBuffer::Reader::forward() {
+    if (is_at_end()) {
+        return false;
+    }
+    char current_char = *position;
+    ++position;
+    ++index;
+    if (current_char == '\n') {
+        ++row;
+        column = 0;
+        ++current_row;
+        row_start_index = index;
+    } else {
+        while (!buffer->is_boundary(position)) {
+            ++position;
+            ++index;
+        }
+        ++column;
+    }
+    return true;
+}
+
+bool TextBuffer::Reader::next_row() {
+    if (std::next(current_row) == buffer->rows.end()) {
+        return false;
+    }
+    row_start_index += current_row->bytes + 1; // including the newline
+    ++current_row;
+    ++row;
+    position = current_row->start;
+    column = 0;
+    index = row_start_index;
+    return true;
+}
+
+TextBuffer::Position TextBuffer::char_count() const {
+    return characters;
+}
+
+TextBuffer::Position TextBuffer::word_count() const {
+    return words;
+}
+
+TextBuffer::Position TextBuffer::longest_row_length() const {
+    return row_lengths.rbegin()->first;
+}
+
+int TextBuffer::subscribe(const Observer &observer) {
+    observers[next_observer_id] = observer;
+    return next_observer_id++;
+}
+
+void TextBuffer::unsubscribe(int id) {
+    observers.erase(id);
+}
+
+void TextBuffer::begin_batch() {
+    if (batch_depth++ == 0) {
+        batch_edited = false;
+    }
+}
+
+void TextBuffer::end_batch() {
+    assert(batch_depth > 0);
+    if (--batch_depth > 0 || !batch_edited || observers.empty()) {
+        return;
+    }
+    Edit edit = describe_range(batch_start, batch_end);
+    edit.removed = batch_removed;
+    for (auto &entry : observers) {
+        entry.second(edit);
+    }
+}
+
+void TextBuffer::visit(Position first, Position last,
+                       const BlockVisitor &visitor) const {
+    assert(0 <= first && first <= last && last <= size());
+    Iterator position = iterator_at(first);
+    std::string block;
+    while (first < last) {
+        Position count = std::min(BLOCK_SIZE, last - first);
+        block.resize(count);
+        for (Position i = 0; i < count; ++i, ++position) {
+            block[i] = *position;
+        }
+        first += count;
+        if (!visitor(block.data(), count)) {
+            return;
+        }
+    }
+}
+
+void TextBuffer::visit_reverse(Position first, Position last,
+                               const BlockVisitor &visitor) const {
+    assert(0 <= first && first <= last && last <= size());
+    Iterator position = iterator_at(last);
+    std::string block;
+    while (first < last) {
+        Position count = std::min(BLOCK_SIZE, last - first);
+        block.resize(count);
+        for (Position i = 0; i < count; ++i) {
+            block[i] = *--position;
+        }
+        last -= count;
+        if (!visitor(block.data(), count)) {
+            return;
+        }
+    }
 }
 
 std::string TextBuffer::stringify() const {
     return std::string(data.begin(), data.end());
 }
 
-int TextBuffer::compute_column() const {
-    if (cursor == data.begin()) {
-        return 0;
-    }
-    
+TextBuffer::Position TextBuffer::compute_column() const {
     auto it = cursor;
-    int col = 0;
+    Position col = 0;
+    char first_char = '\0'; // first byte of the row, once visited
     
     // Move backward to find the start of the current row
-    do {
+    while (it != data.begin()) {
         --it;
         if (*it == '\n') {
             break;
         }
+        first_char = *it;
+        if (column_mode == BYTES || !is_continuation(*it)) {
+            ++col;
+        }
+    }
+    // a continuation byte at the start of a row begins a character
+    if (column_mode == CODEPOINTS && is_continuation(first_char)) {
         ++col;
-    } while (it != data.begin());
+    }
     
     return col;
-}
\ No newline at end of file
+}
+
+bool TextBuffer::is_boundary(Iterator position) const {
+    if (column_mode == BYTES || position == data.end()
+        || position == data.begin() || !is_continuation(*position)) {
+        return true;
+    }
+    return *std::prev(position) == '\n';
+}
+
+void TextBuffer::skip_to_boundary() {
+    while (!is_boundary(cursor)) {
+        ++cursor;
+        ++index;
+    }
+}
+
+void TextBuffer::join_continuation_bytes() {
+    if (!is_boundary(cursor)) {
+        skip_to_boundary();
+        set_row_columns(current_row->columns - 1);
+        --characters;
+    }
+}
+
+void TextBuffer::advance_to_column(Position new_column) {
+    if (new_column >= current_row->columns) {
+        move_to_row_end(); // the row is not that long
+        return;
+    }
+    while (column < new_column) {
+        ++cursor;
+        ++index;
+        skip_to_boundary();
+        ++column;
+    }
+}
+
+void TextBuffer::set_row_columns(Position columns) {
+    count_row_length(current_row->columns, -1);
+    current_row->columns = columns;
+    count_row_length(columns, 1);
+}
+
+void TextBuffer::count_row_length(Position columns, Position change) {
+    if ((row_lengths[columns] += change) == 0) {
+        row_lengths.erase(columns);
+    }
+}
+
+TextBuffer::Iterator TextBuffer::iterator_at(Position target) const {
+    RowList::iterator it = current_row;
+    Position start_index = row_start_index;
+    Position number = row;
+    locate_row(target, it, start_index, number);
+    return std::next(it->start, target - start_index);
+}
+
+void TextBuffer::locate_row(Position target, RowList::iterator &it,
+                            Position &start_index, Position &number) const {
+    while (target < start_index) {
+        --it;
+        --number;
+        start_index -= it->bytes + 1; // including the newline
+    }
+    while (target > start_index + it->bytes) {
+        start_index += it->bytes + 1;
+        ++it;
+        ++number;
+    }
+}
+
+void TextBuffer::rebuild_index() {
+    rows.clear();
+    row_lengths.clear();
+    characters = 0;
+    words = 0;
+    Row entry = { data.begin(), 0, 0 };
+    bool in_word = false;
+    for (Iterator it = data.begin(); it != data.end(); ++it) {
+        words += is_word(*it) && !in_word;
+        in_word = is_word(*it);
+        if (it == cursor) {
+            row_start_index = index - entry.bytes;
+        }
+        if (*it == '\n') {
+            rows.push_back(entry);
+            count_row_length(entry.columns, 1);
+            ++characters;
+            entry = { std::next(it), 0, 0 };
+        } else {
+            ++entry.bytes;
+            if (is_boundary(it)) {
+                ++entry.columns;
+                ++characters;
+            }
+        }
+    }
+    if (cursor == data.end()) {
+        row_start_index = index - entry.bytes;
+    }
+    rows.push_back(entry);
+    count_row_length(entry.columns, 1);
+    current_row = std::next(rows.begin(), row - 1);
+    column = compute_column();
+}
+
+void TextBuffer::notify(Position edit_index, Position edit_row,
+                        Position removed, const char *inserted,
+                        Position count) {
+    if (batch_depth > 0) {
+        if (!batch_edited) {
+            batch_edited = true;
+            batch_start = edit_index;
+            batch_end = edit_index + count;
+            batch_removed = removed;
+            return;
+        }
+        // grow the changed range to cover this edit as well; bytes it
+        // removed from outside the range were part of the original text
+        Position start = std::min(batch_start, edit_index);
+        Position end = std::max(batch_end, edit_index + removed);
+        batch_removed += (batch_start - start) + (end - batch_end);
+        batch_start = start;
+        batch_end = end - removed + count;
+        return;
+    }
+    if (observers.empty()) {
+        return;
+    }
+    Edit edit = { edit_index, removed, std::string(inserted, count),
+                  edit_row, row };
+    for (auto &entry : observers) {
+        entry.second(edit);
+    }
+}
+
+TextBuffer::Edit TextBuffer::describe_range(Position first,
+                                            Position last) const {
+    Iterator it = cursor;
+    Position it_index = index;
+    Position it_row = row;
+    while (it_index > first) {
+        --it;
+        --it_index;
+        it_row -= (*it == '\n');
+    }
+    while (it_index < first) {
+        it_row += (*it == '\n');
+        ++it;
+        ++it_index;
+    }
+    Edit edit = { first, 0, std::string(), it_row, it_row };
+    for (; it_index < last; ++it, ++it_index) {
+        edit.inserted.push_back(*it);
+        edit.last_row += (*it == '\n');
+    }
+    return edit;
+}
+
+TextBuffer::Position TextBuffer::count_columns(const char *first,
+                                               const char *last,
+                                               bool starts_row) const {
+    if (column_mode == BYTES) {
+        return last - first;
+    }
+    Position columns = count_codepoints(first, last);
+    if (starts_row && first != last && is_continuation(*first)) {
+        ++columns;
+    }
+    return columns;
+}
@@ -9,12 +9,56 @@
  * EECS 280 List/Editor Project
  */
 
+#include <array>
+#include <cstdint>
+#include <functional>
 #include <list>
+#include <map>
 #include <string>
 // Uncomment the following line to use your List implementation
 // #include "List.hpp"
 
 class TextBuffer {
+public:
+  // Type used for rows, columns, indices and sizes. It is 64 bits wide
+  // so that buffers (and single rows) beyond 2 GiB are addressable.
+  using Position = std::int64_t;
+
+  // How the characters of a row are counted as columns.
+  enum ColumnMode {
+    BYTES,      // every byte is a column
+    CODEPOINTS  // every UTF-8 encoded codepoint is a column
+  };
+
+  // Description of an edit, as reported to observers. The bytes in
+  // [index, index + removed) were replaced by `inserted`, which now
+  // spans rows first_row through last_row.
+  struct Edit {
+    Position index;        // index of the first byte changed
+    Position removed;      // number of bytes removed at index
+    std::string inserted;  // bytes inserted at index
+    Position first_row;    // row containing index
+    Position last_row;     // row containing the end of the inserted bytes
+  };
+
+  // Function called with each edit, after it has been applied.
+  using Observer = std::function<void(const Edit &)>;
+
+  // Function called with consecutive blocks of the contents by visit()
+  // and visit_reverse().
+  // Returns whether to continue with the next block.
+  using BlockVisitor = std::function<bool(const char *block,
+                                          Position count)>;
+
+  // Maximum number of bytes passed to a BlockVisitor at once.
+  static constexpr Position BLOCK_SIZE = 1 << 16;
+
+  // Set of characters for skip_forward_while() and skip_backward_while(),
+  // with an entry for each value of the first byte of a character, as an
+  // unsigned char.
+  using ByteClass = std::array<bool, 256>;
+
+private:
   // Comment out the following two lines and uncomment the two below
   // to use your List implementation
   using CharList = std::list<char>;
@@ -25,9 +69,34 @@ class TextBuffer {
 private:
   CharList data;           // linked list that contains the characters
   Iterator cursor;         // iterator to current element in the list
-  int row;                 // current row
-  int column;              // current column
-  int index;               // current index
+  Position row;            // current row
+  Position column;         // current column
+  Position index;          // current index
+  ColumnMode column_mode;  // how columns are counted
+
+  // Index entry for one row of the buffer.
+  struct Row {
+    Iterator start;        // first character of the row: its first
+                           // byte, its newline if empty, or end()
+    Position bytes;        // bytes in the row, excluding the newline
+    Position columns;      // columns in the row, excluding the newline
+  };
+  using RowList = std::list<Row>;
+
+  RowList rows;            // one entry per row, in order
+  RowList::iterator current_row; // entry for the row of the cursor
+  Position row_start_index;      // index of the first byte of that row
+  std::map<Position, Position> row_lengths; // rows of each length
+  Position characters;     // characters in the buffer, including newlines
+  Position words;          // maximal runs of non-whitespace characters
+
+  std::map<int, Observer> observers; // subscribed observers, by id
+  int next_observer_id;    // id for the next subscription
+  int batch_depth;         // number of unfinished begin_batch() calls
+  bool batch_edited;       // whether the current batch made any edits
+  Position batch_start;    // start index of the bytes the batch changed
+  Position batch_end;      // end index of those bytes, as of now
+  Position batch_removed;  // length of those bytes before the batch
 
   // INVARIANT (cursor iterator):
   //   `cursor` points at an actual character in the list, or is
@@ -38,6 +107,11 @@ private:
   //   character the cursor is pointing at, determined by the
   //   placement of '\n' newline characters in the buffer.
   //   row is 1-indexed, whereas column is 0-indexed.
+  //   In CODEPOINTS mode, a character is a byte that is not a UTF-8
+  //   continuation byte (10xxxxxx) together with the continuation
+  //   bytes that follow it. A continuation byte at the start of a row
+  //   begins a character of its own. Columns count characters, and
+  //   the cursor always points at the first byte of a character.
 
   // INVARIANT: (index)
   //   `index` is the 0-based index of the character the cursor is
@@ -45,6 +119,14 @@ private:
   //   list if the cursor is at the past-the-end position.
   //   0 <= index <= data.size()
 
+  // INVARIANT (row index and statistics):
+  //   `rows` has an entry for each of the rows of the buffer, and
+  //   `current_row` is the entry for row number `row`, whose first
+  //   byte is at index `row_start_index`. `row_lengths` maps each
+  //   `columns` value of the entries to how many entries have it.
+  //   `characters` and `words` count the characters (in the current
+  //   column mode) and words of the buffer.
+
   // The above invariants are established by the constructor and are
   // assumed to hold at the start of any member function call (i.e.
   // they are implicit conditions in the REQUIRES clause). Each function
@@ -52,10 +134,69 @@ private:
   // function must restore them before it returns).
 
 public:
+  // A read-only position in a TextBuffer that moves forward through its
+  // characters independently of the cursor, as the cursor would, for
+  // walking over part of the text without disturbing the cursor. A
+  // Reader is invalidated by any edit to its buffer.
+  class Reader {
+  public:
+    //EFFECTS: Returns whether the reader is at the past-the-end position.
+    bool is_at_end() const;
+
+    //REQUIRES: the reader is not at the past-the-end position
+    //EFFECTS:  Returns the byte at the reader.
+    char data() const;
+
+    //REQUIRES: the reader is not at the past-the-end position
+    //EFFECTS:  Returns the bytes of the character at the reader, as
+    //          character_at_cursor() would at the same position.
+    std::string character() const;
+
+    //EFFECTS: Returns the row, column and index of the character at the
+    //         reader, as get_row(), get_column() and get_index() would.
+    Position get_row() const;
+    Position get_column() const;
+    Position get_index() const;
+
+    //MODIFIES: *this
+    //EFFECTS:  Moves to the next character, as forward() moves the
+    //          cursor. Returns false if the reader was at the
+    //          past-the-end position.
+    bool forward();
+
+    //MODIFIES: *this
+    //EFFECTS:  Moves to the start of the next row in constant time, and
+    //          returns true, unless the reader is in the last row, in
+    //          which case this does nothing and returns false.
+    bool next_row();
+
+  private:
+    friend class TextBuffer;
+
+    const TextBuffer *buffer;
+    Iterator position;
+    RowList::const_iterator current_row;
+    Position row_start_index;
+    Position row;
+    Position column;
+    Position index;
+  };
+
   //EFFECTS: Creates an empty text buffer. Its cursor is at the past-the-end
-  //         position, with row 1, column 0, and index 0.
+  //         position, with row 1, column 0, and index 0. Columns are
+  //         counted in BYTES mode.
   TextBuffer();
 
+  //MODIFIES: *this
+  //EFFECTS:  Sets how columns are counted. Switching to CODEPOINTS mode
+  //          moves the cursor back to the first byte of its character.
+  //          Movement, insertion and removal then operate on whole
+  //          characters, while indices continue to count bytes.
+  void set_column_mode(ColumnMode mode);
+
+  //EFFECTS:  Returns how columns are counted.
+  ColumnMode get_column_mode() const;
+
   //MODIFIES: *this
   //EFFECTS:  Moves the cursor one position forward and returns true,
   //          unless the cursor is already at the past-the-end position,
@@ -84,6 +225,22 @@ public:
   //          if appropriate to maintain all invariants.
   void insert(char c);
 
+  //REQUIRES: chars points to at least count characters
+  //MODIFIES: *this
+  //EFFECTS:  Inserts the count characters starting at chars in the buffer
+  //          before the cursor position, with the same result as calling
+  //          insert() on each of them in order. Rows and columns are
+  //          updated with vectorized newline scanning.
+  void insert(const char *chars, Position count);
+
+  //REQUIRES: chars points to at least count characters
+  //MODIFIES: *this
+  //EFFECTS:  Inserts the count characters starting at chars at the end of
+  //          the buffer, as insert() would at the past-the-end position,
+  //          without moving the cursor: it stays on the same character,
+  //          or at the same index if it was at the past-the-end position.
+  void append(const char *chars, Position count);
+
   //MODIFIES: *this
   //EFFECTS:  Removes the character from the buffer that is at the cursor and
   //          returns true, unless the cursor is at the past-the-end position,
@@ -95,6 +252,23 @@ public:
   //          if appropriate to maintain all invariants.
   bool remove();
 
+  //REQUIRES: 0 <= count <= size() - get_index(), and the byte count
+  //          bytes after the cursor starts a character (or is the
+  //          past-the-end position)
+  //MODIFIES: *this
+  //EFFECTS:  Removes the count bytes starting at the cursor, with the same
+  //          result as calling remove() until they are gone, but with one
+  //          erase of the underlying list and one pass over the bytes.
+  //          Observers are notified of a single edit.
+  void erase(Position count);
+
+  //REQUIRES: the same as erase(count)
+  //MODIFIES: *this, destination
+  //EFFECTS:  Removes the count bytes starting at the cursor as erase()
+  //          does, and appends them to destination, which they are
+  //          copied into once, in order.
+  void cut(Position count, std::string &destination);
+
   //MODIFIES: *this
   //EFFECTS:  Moves the cursor to the start of the current row (column 0).
   //NOTE:     Your implementation must update the row, column, and index
@@ -118,7 +292,43 @@ public:
   //          the last one in the buffer).
   //NOTE:     Your implementation must update the row, column, and index
   //          if appropriate to maintain all invariants.
-  void move_to_column(int new_column);
+  void move_to_column(Position new_column);
+
+  //REQUIRES: 0 <= new_index <= size()
+  //MODIFIES: *this
+  //EFFECTS:  Moves the cursor to the character at the given index, or
+  //          to the start of the character containing it. Runs in time
+  //          proportional to the number of rows between the current
+  //          and new positions plus the new column, or to the distance
+  //          moved if the new index is ahead in the current row.
+  void move_to_index(Position new_index);
+
+  //REQUIRES: 1 <= row_number <= row_count(), new_column >= 0
+  //MODIFIES: *this
+  //EFFECTS:  Moves the cursor to the given column of the given row, or
+  //          to the end of the row if it does not have that many
+  //          columns. Runs in time proportional to the distance to that
+  //          row from the current row or the nearest end, in entries of
+  //          the row index, plus the new column.
+  void move_to_row(Position row_number, Position new_column);
+
+  //MODIFIES: *this
+  //EFFECTS:  Moves the cursor forward over the characters at the cursor
+  //          as long as they are in byte_class, stopping at the first
+  //          one that is not, or at the past-the-end position. The same
+  //          as calling forward() while the character at the cursor is
+  //          in the class, but scans the bytes directly and updates the
+  //          column and index once. Returns whether the cursor moved.
+  bool skip_forward_while(const ByteClass &byte_class);
+
+  //MODIFIES: *this
+  //EFFECTS:  Moves the cursor backward over the characters before the
+  //          cursor as long as they are in byte_class, stopping after
+  //          the first one that is not, or at the first character in
+  //          the buffer. The same as calling backward() while the
+  //          character before the cursor is in the class, but scans the
+  //          bytes directly. Returns whether the cursor moved.
+  bool skip_backward_while(const ByteClass &byte_class);
 
   //MODIFIES: *this
   //EFFECTS:  Moves the cursor to the previous row, retaining the
@@ -152,19 +362,92 @@ public:
   //EFFECTS:  Returns the character at the current cursor
   char data_at_cursor() const;
 
+  //REQUIRES: the cursor is not at the past-the-end position
+  //EFFECTS:  Returns the bytes of the character at the current cursor:
+  //          a single byte in BYTES mode, or the UTF-8 sequence starting
+  //          at the cursor in CODEPOINTS mode.
+  std::string character_at_cursor() const;
+
   //EFFECTS:  Returns the row of the character at the current cursor.
-  int get_row() const;
+  Position get_row() const;
 
   //EFFECTS:  Returns the column of the character at the current cursor.
-  int get_column() const;
+  Position get_column() const;
 
   //EFFECTS:  Returns the index of the character at the current cursor
   //          with respect to the entire contents. If the cursor is at
   //          the past-the-end position, returns size() as the index.
-  int get_index() const;
+  Position get_index() const;
 
   //EFFECTS:  Returns the number of characters in the buffer.
-  int size() const;
+  Position size() const;
+
+  //EFFECTS:  Returns the number of rows in the buffer, which is one
+  //          more than the number of newlines. Runs in constant time.
+  Position row_count() const;
+
+  //REQUIRES: 1 <= row_number <= row_count()
+  //EFFECTS:  Returns the number of columns in the given row, excluding
+  //          its newline. Runs in time proportional to the distance to
+  //          that row from the current row or the nearest end.
+  Position row_length(Position row_number) const;
+
+  //REQUIRES: 1 <= row_number <= row_count()
+  //EFFECTS:  Returns a Reader at the start of the given row. Runs in time
+  //          proportional to the distance to that row from the current
+  //          row or the nearest end.
+  Reader reader_at_row(Position row_number) const;
+
+  //EFFECTS:  Returns the number of characters in the buffer, including
+  //          newlines. This is size() in BYTES mode, and the number of
+  //          UTF-8 characters in CODEPOINTS mode. Runs in constant time.
+  Position char_count() const;
+
+  //EFFECTS:  Returns the number of words in the buffer, where a word is
+  //          a maximal run of non-whitespace characters (as counted by
+  //          wc -w). Runs in constant time.
+  Position word_count() const;
+
+  //EFFECTS:  Returns the number of columns in the longest row of the
+  //          buffer, excluding its newline. Runs in constant time.
+  Position longest_row_length() const;
+
+  //MODIFIES: *this
+  //EFFECTS:  Registers an observer that is called after each edit (or
+  //          each batch of edits) to the contents, and returns an id
+  //          that can be passed to unsubscribe(). Observers must not
+  //          edit the buffer or change the set of observers.
+  int subscribe(const Observer &observer);
+
+  //MODIFIES: *this
+  //EFFECTS:  Removes the observer with the given id, if it exists.
+  void unsubscribe(int id);
+
+  //MODIFIES: *this
+  //EFFECTS:  Starts a batch of edits. Until the matching end_batch(),
+  //          observers are not called; the edits are instead combined
+  //          into a single Edit covering every byte they changed.
+  //          Batches may be nested; only the outermost one notifies.
+  void begin_batch();
+
+  //REQUIRES: a batch was started by begin_batch()
+  //MODIFIES: *this
+  //EFFECTS:  Ends a batch of edits, notifying observers of the combined
+  //          edit if this is the outermost batch and it changed anything.
+  void end_batch();
+
+  //REQUIRES: 0 <= first <= last <= size()
+  //EFFECTS:  Calls visitor with the bytes in [first, last), copied into
+  //          consecutive blocks of at most BLOCK_SIZE bytes, until it
+  //          returns false. The cursor does not move.
+  void visit(Position first, Position last,
+             const BlockVisitor &visitor) const;
+
+  //REQUIRES: 0 <= first <= last <= size()
+  //EFFECTS:  Like visit(), but visits the bytes in [first, last) from
+  //          last back to first, so each block holds them in reverse.
+  void visit_reverse(Position first, Position last,
+                     const BlockVisitor &visitor) const;
 
   //EFFECTS:  Returns the contents of the text buffer as a string.
   //HINT: Implement this using the string constructor that takes a
@@ -176,7 +459,73 @@ private:
   //EFFECTS: Computes the column of the cursor within the current row.
   //NOTE: This does not assume that the "column" member variable has
   //      a correct value (i.e. the row/column INVARIANT can be broken).
-  int compute_column() const;
+  Position compute_column() const;
+
+  //EFFECTS: Returns whether the given position starts a character
+  //         (always true in BYTES mode).
+  bool is_boundary(Iterator position) const;
+
+  //MODIFIES: *this
+  //EFFECTS:  Moves the cursor forward over UTF-8 continuation bytes
+  //          until it starts a character. Does not change the column.
+  void skip_to_boundary();
+
+  //MODIFIES: *this
+  //EFFECTS:  Handles an insertion or removal that made the bytes at the
+  //          cursor continue the character before them. They were a
+  //          character of their own at the start of a row, so the cursor
+  //          moves past them and the current row loses a column.
+  void join_continuation_bytes();
+
+  //MODIFIES: *this
+  //EFFECTS:  Moves the cursor forward from the start of the current row
+  //          to the given column, or to the end of the row if it is
+  //          shorter.
+  void advance_to_column(Position new_column);
+
+  //MODIFIES: *this
+  //EFFECTS:  Sets the number of columns in the current row.
+  void set_row_columns(Position columns);
+
+  //MODIFIES: *this
+  //EFFECTS:  Adds (if change is 1) or removes (if change is -1) a row
+  //          with the given number of columns from row_lengths.
+  void count_row_length(Position columns, Position change);
+
+  //REQUIRES: 0 <= target <= size()
+  //EFFECTS:  Returns an iterator to the byte at the target index, found
+  //          by way of the row index.
+  Iterator iterator_at(Position target) const;
+
+  //REQUIRES: 0 <= target <= size(), and start_index and number are the
+  //          index of the first byte and the number of the row at it
+  //EFFECTS:  Moves it (along with start_index and number) to the row
+  //          containing the byte at the target index.
+  void locate_row(Position target, RowList::iterator &it,
+                  Position &start_index, Position &number) const;
+
+  //MODIFIES: *this
+  //EFFECTS:  Rebuilds the row index and statistics from the contents.
+  void rebuild_index();
+
+  //REQUIRES: the edit has been applied, and the cursor is at or after
+  //          the end of its inserted bytes, in its last row
+  //MODIFIES: *this
+  //EFFECTS:  Reports the edit of removed bytes at the given index and
+  //          row, replaced by count bytes at inserted, to observers (or
+  //          adds it to the current batch).
+  void notify(Position edit_index, Position edit_row, Position removed,
+              const char *inserted, Position count);
+
+  //EFFECTS:  Returns the bytes in [first, last) and the rows containing
+  //          first and last, by walking from the cursor.
+  Edit describe_range(Position first, Position last) const;
+
+  //EFFECTS: Returns the number of columns taken by the characters in
+  //         [first, last), where starts_row is whether first is at the
+  //         start of a row.
+  Position count_columns(const char *first, const char *last,
+                         bool starts_row) const;
 };
 
 #endif // TEXTBUFFER_HPP
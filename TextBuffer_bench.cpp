@@ -0,0 +1,641 @@
+/* TextBuffer_bench.cpp
+ *
+ * Throughput benchmarks for the TextBuffer and its scanning
+ * primitives. Run with `make bench`.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <regex>
+#include <string>
+#include <sys/resource.h>
+#include "AtomicFile.hpp"
+#include "CharScan.hpp"
+#include "Regex.hpp"
+#include "Search.hpp"
+#include "TextBuffer.hpp"
+
+using namespace std;
+
+using bench_clock = chrono::steady_clock;
+
+// Returns the number of seconds elapsed since start.
+static double seconds_since(bench_clock::time_point start) {
+  return chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+// Builds a text with the given number of rows of varying length.
+static string make_rows(long rows) {
+  string text;
+  for (long i = 0; i < rows; ++i) {
+    text.append(20 + i % 60, 'a' + i % 26);
+    text.push_back('\n');
+  }
+  return text;
+}
+
+static const char * level_name(ScanLevel level) {
+  switch (level) {
+  case ScanLevel::AVX2: return "avx2";
+  case ScanLevel::SSE2: return "sse2";
+  default: return "scalar";
+  }
+}
+
+// Newline counting and goto-line/page-down style newline seeks over
+// contiguous text, at every supported scan level.
+static void bench_scan(long rows) {
+  string text = make_rows(rows);
+  const char *first = text.data(), *last = first + text.size();
+  printf("newline scanning, %ld rows (%.0f MB)\n", rows, text.size() / 1e6);
+  for (ScanLevel level : { ScanLevel::SCALAR, ScanLevel::SSE2,
+                           ScanLevel::AVX2 }) {
+    if (level > max_scan_level()) {
+      continue;
+    }
+    set_scan_level(level);
+
+    auto start = bench_clock::now();
+    size_t count = count_char(first, last, '\n');
+    double count_time = seconds_since(start);
+
+    // goto-line to the last row: one seek per newline
+    start = bench_clock::now();
+    const char *p = first;
+    for (long row = 1; row < rows; ++row) {
+      p = find_char(p, last, '\n') + 1;
+    }
+    double goto_time = seconds_since(start);
+
+    // page-down through the whole text, 50 rows per page
+    start = bench_clock::now();
+    long pages = 0;
+    for (p = first; p != last; ++pages) {
+      for (int i = 0; i < 50 && p != last; ++i) {
+        p = find_char(p, last, '\n') + 1;
+      }
+    }
+    double page_time = seconds_since(start);
+
+    printf("  %-6s count %6.0f MB/s (%zu)  goto-line %6.0f MB/s"
+           "  page-down %6.0f MB/s (%ld pages)\n",
+           level_name(level), text.size() / 1e6 / count_time, count,
+           text.size() / 1e6 / goto_time, text.size() / 1e6 / page_time,
+           pages);
+  }
+  set_scan_level(max_scan_level());
+}
+
+// Loading text into a TextBuffer one character at a time versus in
+// bulk blocks, as femto does when reading a file.
+static void bench_load(long rows) {
+  string text = make_rows(rows);
+  printf("loading %ld rows (%.0f MB) into a TextBuffer\n",
+         rows, text.size() / 1e6);
+  {
+    auto start = bench_clock::now();
+    TextBuffer buffer;
+    for (char c : text) {
+      buffer.insert(c);
+    }
+    printf("  per-char insert %6.1f MB/s\n",
+           text.size() / 1e6 / seconds_since(start));
+  }
+  {
+    const size_t BLOCK = 1 << 16;
+    auto start = bench_clock::now();
+    TextBuffer buffer;
+    for (size_t i = 0; i < text.size(); i += BLOCK) {
+      buffer.insert(text.data() + i, min(BLOCK, text.size() - i));
+    }
+    printf("  bulk insert     %6.1f MB/s\n",
+           text.size() / 1e6 / seconds_since(start));
+  }
+}
+
+// Cursor motion over ASCII text in BYTES mode versus UTF-8 text in
+// CODEPOINTS mode, in MB/s of text traversed.
+static void bench_motion(long rows) {
+  const string ascii_unit = "abcdefgh";
+  const string utf8_unit = "ab\xC3\xA9\xE4\xB8\xAD"; // same byte count
+  printf("cursor motion over %ld rows\n", rows);
+  for (bool utf8 : { false, true }) {
+    string text;
+    for (long i = 0; i < rows; ++i) {
+      for (int j = 0; j < 8; ++j) {
+        text += utf8 ? utf8_unit : ascii_unit;
+      }
+      text.push_back('\n');
+    }
+    TextBuffer buffer;
+    buffer.set_column_mode(utf8 ? TextBuffer::CODEPOINTS
+                                : TextBuffer::BYTES);
+    buffer.insert(text.data(), text.size());
+
+    auto start = bench_clock::now();
+    while (buffer.backward());
+    while (buffer.forward());
+    double step_time = seconds_since(start);
+
+    start = bench_clock::now();
+    while (buffer.up());
+    while (buffer.down());
+    double row_time = seconds_since(start);
+
+    printf("  %-5s backward/forward %6.1f MB/s  up/down %6.1f MB/s\n",
+           utf8 ? "utf-8" : "ascii", 2 * text.size() / 1e6 / step_time,
+           2 * text.size() / 1e6 / row_time);
+  }
+}
+
+// Walks the rest of the row from the reader or cursor, up to a window
+// width of characters, as femto does when it renders a row. Returns a
+// checksum of the characters walked.
+template <typename Walker>
+static long walk_row(Walker &walker, bool (Walker::*at_end)() const,
+                     char (Walker::*data)() const) {
+  const int WIDTH = 80;
+  long sum = 0;
+  TextBuffer::Position row = walker.get_row();
+  for (int x = 0; x < WIDTH && !(walker.*at_end)()
+         && walker.get_row() == row; ++x, walker.forward()) {
+    sum += (walker.*data)();
+  }
+  return sum;
+}
+
+// Rendering the rows of a viewport in the middle of a large buffer, by
+// moving the cursor to each row and back as femto did, versus one pass
+// with a Reader, at several terminal heights.
+static void bench_viewport(long rows) {
+  string text = make_rows(rows);
+  TextBuffer buffer;
+  buffer.insert(text.data(), text.size());
+  TextBuffer::Position cursor_row = rows / 2;
+  buffer.move_to_index(0);
+  while (buffer.get_row() < cursor_row && buffer.down());
+  printf("rendering a viewport of a %ld-row buffer\n", rows);
+  for (int height : { 24, 60, 120, 240 }) {
+    const int FRAMES = 2000;
+    TextBuffer::Position baseline = cursor_row - height / 2;
+    long sum = 0;
+    auto start = bench_clock::now();
+    for (int frame = 0; frame < FRAMES; ++frame) {
+      TextBuffer::Position column = buffer.get_column();
+      for (TextBuffer::Position row = baseline; row < baseline + height;
+           ++row) {
+        buffer.move_to_row_start();
+        while (buffer.get_row() < row && buffer.down());
+        while (buffer.get_row() > row && buffer.up());
+        sum += walk_row(buffer, &TextBuffer::is_at_end,
+                        &TextBuffer::data_at_cursor);
+      }
+      buffer.move_to_row_start();
+      while (buffer.get_row() > cursor_row && buffer.up());
+      buffer.move_to_column(column);
+    }
+    double cursor_time = seconds_since(start) / FRAMES;
+
+    start = bench_clock::now();
+    for (int frame = 0; frame < FRAMES; ++frame) {
+      TextBuffer::Reader reader = buffer.reader_at_row(baseline);
+      for (TextBuffer::Position row = baseline; row < baseline + height;
+           ++row) {
+        while (reader.get_row() < row && reader.next_row());
+        sum -= walk_row(reader, &TextBuffer::Reader::is_at_end,
+                        &TextBuffer::Reader::data);
+      }
+    }
+    double reader_time = seconds_since(start) / FRAMES;
+    printf("  %3d rows  cursor %7.1f us/frame  reader %7.1f us/frame%s\n",
+           height, cursor_time * 1e6, reader_time * 1e6,
+           sum == 0 ? "" : " (mismatch)");
+  }
+}
+
+// Paging from the top of a large buffer to the bottom a screenful at a
+// time, keeping the column, by stepping down row by row as femto did
+// versus seeking to the row through the row index.
+static void bench_paging(long rows) {
+  const TextBuffer::Position PAGE = 60;
+  string text = make_rows(rows);
+  TextBuffer buffer;
+  buffer.insert(text.data(), text.size());
+  printf("paging through a %ld-row buffer, %ld rows per page\n",
+         rows, static_cast<long>(PAGE));
+  long pages = 0;
+  TextBuffer::Position stepped = 0;
+  buffer.move_to_index(0);
+  buffer.move_to_column(40);
+  auto start = bench_clock::now();
+  for (TextBuffer::Position row = 1; row < buffer.row_count();
+       row += PAGE, ++pages) {
+    TextBuffer::Position column = buffer.get_column();
+    while (buffer.get_row() < row + PAGE && buffer.down());
+    buffer.move_to_column(column);
+    stepped += buffer.get_index();
+  }
+  double step_time = seconds_since(start);
+
+  buffer.move_to_index(0);
+  buffer.move_to_column(40);
+  start = bench_clock::now();
+  for (TextBuffer::Position row = 1; row < buffer.row_count();
+       row += PAGE) {
+    buffer.move_to_row(min(row + PAGE, buffer.row_count()),
+                       buffer.get_column());
+    stepped -= buffer.get_index();
+  }
+  double seek_time = seconds_since(start);
+  printf("  down()   %8.1f ms total %6.2f us/page\n"
+         "  seek     %8.1f ms total %6.2f us/page%s\n",
+         step_time * 1e3, step_time / pages * 1e6,
+         seek_time * 1e3, seek_time / pages * 1e6,
+         stepped == 0 ? "" : " (mismatch)");
+}
+
+// Cutting rows from the top of a large buffer one at a time, by
+// removing a character at a time as femto did versus cutting each row
+// in one edit, with an observer subscribed as femto's journal is.
+static void bench_cut(long rows, long cuts) {
+  string text = make_rows(rows);
+  printf("cutting %ld rows from a %ld-row buffer\n", cuts, rows);
+  double times[2];
+  string kills[2];
+  for (int range = 0; range < 2; ++range) {
+    TextBuffer buffer;
+    buffer.insert(text.data(), text.size());
+    long edits = 0;
+    buffer.subscribe([&](const TextBuffer::Edit &) { ++edits; });
+    buffer.move_to_index(0);
+    auto start = bench_clock::now();
+    for (long i = 0; i < cuts; ++i) {
+      buffer.move_to_row_end();
+      TextBuffer::Position end = buffer.get_index() + !buffer.is_at_end();
+      buffer.move_to_row_start();
+      TextBuffer::Position count = end - buffer.get_index();
+      if (range) {
+        buffer.cut(count, kills[range]);
+      } else {
+        for (TextBuffer::Position j = 0; j < count; ++j) {
+          kills[range].push_back(buffer.data_at_cursor());
+          buffer.remove();
+        }
+      }
+    }
+    times[range] = seconds_since(start);
+  }
+  printf("  per-char remove %7.2f us/row  cut %7.2f us/row%s\n",
+         times[0] / cuts * 1e6, times[1] / cuts * 1e6,
+         kills[0] == kills[1] ? "" : " (mismatch)");
+}
+
+// Word motion over a row of long alphanumeric tokens, such as a base64
+// blob, by testing the character at the cursor and stepping a
+// character at a time as femto did, versus skipping through a class
+// table, in MB/s of text traversed.
+static void bench_word_motion(size_t size) {
+  const size_t TOKEN = 1 << 20;
+  const char DIGITS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+                        "0123456789";
+  string text;
+  unsigned state = 1;
+  while (text.size() < size) {
+    for (size_t i = 0; i < TOKEN; ++i) {
+      state = state * 1103515245 + 12345;
+      text.push_back(DIGITS[(state >> 16) % 62]);
+    }
+    text += " == ";
+  }
+  TextBuffer::ByteClass alphanumeric, other;
+  for (int c = 0; c < 256; ++c) {
+    alphanumeric[c] = isalnum(c);
+    other[c] = !alphanumeric[c];
+  }
+  auto is_alphanumeric = [](const TextBuffer &buffer) {
+    return !buffer.is_at_end() && isalnum(
+      static_cast<unsigned char>(buffer.data_at_cursor()));
+  };
+  TextBuffer buffer;
+  buffer.insert(text.data(), text.size());
+  printf("word motion over %.0f MB of %zu-byte tokens\n",
+         text.size() / 1e6, TOKEN);
+
+  buffer.move_to_index(0);
+  auto start = bench_clock::now();
+  while (!buffer.is_at_end()) {
+    while (is_alphanumeric(buffer) && buffer.forward());
+    while (!is_alphanumeric(buffer) && buffer.forward());
+  }
+  double step_right = seconds_since(start);
+  start = bench_clock::now();
+  while (buffer.get_index() > 0) {
+    while (is_alphanumeric(buffer) && buffer.backward());
+    while (!is_alphanumeric(buffer) && buffer.backward());
+  }
+  double step_left = seconds_since(start);
+
+  start = bench_clock::now();
+  while (!buffer.is_at_end()) {
+    buffer.skip_forward_while(alphanumeric);
+    buffer.skip_forward_while(other);
+  }
+  double skip_right = seconds_since(start);
+  start = bench_clock::now();
+  while (buffer.get_index() > 0) {
+    if (is_alphanumeric(buffer)) {
+      buffer.skip_backward_while(alphanumeric);
+    }
+    buffer.skip_backward_while(other);
+    buffer.backward();
+  }
+  double skip_left = seconds_since(start);
+  printf("  step  right %7.1f MB/s  left %7.1f MB/s\n"
+         "  skip  right %7.1f MB/s  left %7.1f MB/s\n",
+         text.size() / 1e6 / step_right, text.size() / 1e6 / step_left,
+         text.size() / 1e6 / skip_right, text.size() / 1e6 / skip_left);
+}
+
+// Builds a text of roughly the given size from a small vocabulary, in
+// rows of about ten words.
+static string make_words(size_t size) {
+  static const char *const WORDS[] = {
+    "the", "editor", "buffer", "of", "a", "row", "column", "and",
+    "cursor", "text", "to", "search", "in", "line", "file", "is"
+  };
+  string text;
+  text.reserve(size + 16);
+  unsigned state = 1;
+  for (long words = 1; text.size() < size; ++words) {
+    state = state * 1103515245 + 12345;
+    text += WORDS[(state >> 16) % 16];
+    text.push_back(words % 10 == 0 ? '\n' : ' ');
+  }
+  return text;
+}
+
+// The previous femto search: a window of the last size bytes, compared
+// against the pattern after every byte.
+static const char * find_window(const char *first, const char *last,
+                                const string &pattern) {
+  deque<char> search(pattern.begin(), pattern.end());
+  deque<char> window;
+  for (const char *p = first; p != last; ++p) {
+    if (window.size() == search.size()) {
+      window.pop_front();
+    }
+    window.push_back(*p);
+    if (window == search) {
+      return p + 1 - pattern.size();
+    }
+  }
+  return last;
+}
+
+// Times a search of text for a pattern that does not occur in it, in
+// MB/s, checking that each implementation agrees.
+static void time_search(const char *name, const string &text,
+                        const string &pattern, size_t window_bytes) {
+  const char *first = text.data(), *last = first + text.size();
+  printf("  %-28s", name);
+  auto time = [&](const function<const char *()> &search, double size) {
+    auto start = bench_clock::now();
+    const char *found = search();
+    printf(" %7.0f", size / 1e6 / seconds_since(start));
+    return found;
+  };
+  Searcher searcher(pattern);
+  const char *found = time([&] { return searcher.find(first, last); },
+                           text.size());
+  size_t expected = text.find(pattern);
+  time([&] {
+    size_t offset = text.find(pattern);
+    return offset == string::npos ? last : first + offset;
+  }, text.size());
+  boyer_moore_horspool_searcher<string::const_iterator> std_searcher(
+    pattern.begin(), pattern.end());
+  time([&] {
+    return first + (search(text.begin(), text.end(), std_searcher)
+                    - text.begin());
+  },
+       text.size());
+  // the old search is far slower, so it is timed on a prefix
+  time([&] { return find_window(first, first + window_bytes, pattern); },
+       window_bytes);
+  printf("%s\n", (expected == string::npos ? found == last
+                   : found == first + expected) ? "" : "  MISMATCH");
+}
+
+// Substring search over a 1 GB text with the Searcher, std::string::find,
+// std::boyer_moore_horspool_searcher and the old window search, then
+// through a TextBuffer with find_in.
+static void bench_search(size_t size) {
+  {
+    string text = make_words(size);
+    printf("substring search, %.0f MB of words (MB/s)\n", text.size() / 1e6);
+    printf("  %-28s %7s %7s %7s %7s\n", "pattern", "femto", "find",
+           "std-bmh", "old");
+    time_search("short (6 bytes)", text, "cursos", 50000000);
+    time_search("medium (12 bytes)", text, "search rows ", 50000000);
+    time_search("long (36 bytes)", text,
+                "the editor buffer of a row column in", 50000000);
+  }
+  {
+    string text(size / 4, 'a');
+    printf("periodic worst case, %.0f MB of 'a'\n", text.size() / 1e6);
+    time_search("a{6}b", text, "aaaaaab", 50000000);
+    time_search("a{6}ba (Two-Way)", text, "aaaaaaba", 50000000);
+    time_search("a{38}ba (Two-Way)", text, string(38, 'a') + "ba",
+                50000000);
+  }
+  {
+    string text = make_words(size / 64);
+    TextBuffer buffer;
+    buffer.insert(text.data(), text.size());
+    Searcher searcher("the editor buffer of a row column in");
+    auto start = bench_clock::now();
+    TextBuffer::Position found = find_in(buffer, searcher, 0, buffer.size());
+    printf("find_in over a %.0f MB TextBuffer %7.0f MB/s (%s)\n",
+           text.size() / 1e6, text.size() / 1e6 / seconds_since(start),
+           found == -1 ? "not found" : "found");
+  }
+}
+
+// Times typing pattern one byte at a time into an incremental search
+// of text from its middle, each search starting from the previous match
+// (if resume) or from the middle, and moving the cursor to the match
+// as femto does. Prints the slowest keystroke and the total for the
+// whole pattern.
+static void time_incremental(TextBuffer &text, const string &pattern,
+                             bool resume) {
+  TextBuffer::Position origin = text.size() / 2, found = origin;
+  text.move_to_index(origin);
+  double slowest = 0, total = 0;
+  for (size_t typed = 1; typed <= pattern.size() && found != -1; ++typed) {
+    Searcher searcher(pattern.substr(0, typed));
+    auto start = bench_clock::now();
+    TextBuffer::Position from = resume ? found : origin;
+    found = find_in(text, searcher, from, text.size());
+    if (found == -1) {
+      found = find_in(text, searcher, 0, from);
+    }
+    if (found != -1) {
+      text.move_to_index(found);
+    }
+    double elapsed = seconds_since(start);
+    slowest = max(slowest, elapsed);
+    total += elapsed;
+  }
+  printf("  %-8s %-26s %8.3f %8.3f%s\n", resume ? "resume" : "rescan",
+         pattern.c_str(), slowest * 1e3, total * 1e3,
+         found == -1 ? " (not found)" : "");
+}
+
+// Benchmarks typing into an incremental search.
+static void bench_incremental(size_t size) {
+  string words = make_words(size);
+  TextBuffer text;
+  text.insert(words.data(), words.size());
+  printf("incremental search, %.0f MB TextBuffer (ms)\n",
+         text.size() / 1e6);
+  printf("  %-35s %8s %8s\n", "", "slowest", "total");
+  for (bool resume : { false, true }) {
+    time_incremental(text, "search the editor row", resume);
+    time_incremental(text, "cursor in file is a text", resume);
+  }
+}
+
+// Benchmarks replacing every occurrence of a word in a TextBuffer, in
+// lines of ten words and then in a single row.
+static void bench_replace(size_t size) {
+  string words = make_words(size);
+  for (bool one_row : { false, true }) {
+    if (one_row) {
+      replace(words.begin(), words.end(), '\n', ' ');
+    }
+    TextBuffer text;
+    text.insert(words.data(), words.size());
+    text.move_to_index(0);
+    Searcher searcher("cursor");
+    auto start = bench_clock::now();
+    TextBuffer::Position replaced =
+      replace_all(text, 0, substring_finder(searcher), "caret");
+    printf("replace all in a %.0f MB TextBuffer%s: %ld matches in %.3f s\n",
+           words.size() / 1e6, one_row ? " of one row" : "",
+           static_cast<long>(replaced), seconds_since(start));
+  }
+}
+
+// Builds a log-like text of about the given size, with one line that
+// matches each benchmark pattern at the very end.
+static string make_log(size_t size) {
+  static const char *levels[] = { "INFO", "DEBUG", "WARN" };
+  string text;
+  for (long i = 0; text.size() < size; ++i) {
+    text += "2024-05-" + to_string(10 + i % 20) + " " + levels[i % 3]
+      + " worker " + to_string(i % 97) + ": request " + to_string(i)
+      + " served in " + to_string(i % 1000) + " ms\n";
+  }
+  text += "2024-05-31 ERROR worker 3: upstream timeout from 10.0.0.7\n";
+  return text;
+}
+
+// Times the femto regex engine and std::regex on text. std::regex,
+// being much slower, only searches the last std_size bytes.
+static void time_regex(const char *pattern, const string &text,
+                       size_t std_size) {
+  Regex regex(pattern, false);
+  Regex::Match match;
+  auto start = bench_clock::now();
+  bool found = regex.search(text.data(), text.data() + text.size(), match);
+  double femto = text.size() / 1e6 / seconds_since(start);
+
+  string tail = text.substr(text.size() - std_size);
+  std::regex reference(pattern);
+  start = bench_clock::now();
+  bool std_found = regex_search(tail, reference);
+  double std_rate = tail.size() / 1e6 / seconds_since(start);
+  printf("  %-36s %7.0f %7.1f%s\n", pattern, femto, std_rate,
+         found && std_found ? "" : " (not found)");
+}
+
+// Benchmarks regular expression search on a log-like text.
+static void bench_regex(size_t size) {
+  string text = make_log(size);
+  printf("regex search, %.0f MB of log lines (MB/s)\n", text.size() / 1e6);
+  printf("  %-36s %7s %7s\n", "pattern", "femto", "std");
+  time_regex("ERROR.*timeout", text, 4000000);
+  time_regex("[0-9]+\\.[0-9]+\\.[0-9]+\\.[0-9]+", text, 4000000);
+  time_regex("(WARN|ERROR) worker [0-9]+: upstream", text, 4000000);
+
+  TextBuffer buffer;
+  size_t tail = size / 16;
+  buffer.insert(text.data() + text.size() - tail, tail);
+  Regex regex("ERROR.*timeout", false);
+  Regex::Match match;
+  auto start = bench_clock::now();
+  bool found = regex.find_in(buffer, 0, buffer.size(), match);
+  printf("find_in over a %.0f MB TextBuffer %7.0f MB/s (%s)\n",
+         buffer.size() / 1e6, buffer.size() / 1e6 / seconds_since(start),
+         found ? "found" : "not found");
+}
+
+// Returns the peak resident memory of the process so far, in MB.
+static double peak_megabytes() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1e3;
+}
+
+// Benchmarks saving a TextBuffer by streaming it to a temporary file
+// that is renamed over the target, against building one string of the
+// whole buffer and writing that.
+static void bench_save(size_t size) {
+  string words = make_words(size);
+  TextBuffer text;
+  text.insert(words.data(), words.size());
+  words = string();
+  const char *filename = "TextBuffer_bench.tmp";
+  printf("save a %.0f MB TextBuffer    MB/s  peak RSS growth (MB)\n",
+         text.size() / 1e6);
+  // the streaming saves run first, so that growth of the peak is theirs
+  for (bool sync : { false, true }) {
+    double peak = peak_megabytes();
+    auto start = bench_clock::now();
+    string error;
+    bool saved = save_text(text, filename, sync, error);
+    printf("  %-24s %7.0f %8.1f%s\n", sync ? "streamed, fsync" : "streamed",
+           text.size() / 1e6 / seconds_since(start),
+           peak_megabytes() - peak, saved ? "" : " (failed)");
+  }
+  double peak = peak_megabytes();
+  auto start = bench_clock::now();
+  {
+    ofstream output(filename);
+    output << text.stringify();
+  }
+  printf("  %-24s %7.0f %8.1f\n", "stringify, ofstream",
+         text.size() / 1e6 / seconds_since(start), peak_megabytes() - peak);
+  remove(filename);
+}
+
+int main() {
+  printf("scan level: %s\n", level_name(scan_level()));
+  bench_scan(10000000);
+  bench_load(1000000);
+  bench_motion(200000);
+  bench_viewport(1000000);
+  bench_paging(1000000);
+  bench_cut(1000000, 100000);
+  bench_word_motion(64000000);
+  bench_search(1000000000);
+  bench_regex(64000000);
+  bench_incremental(32000000);
+  bench_replace(32000000);
+  bench_save(64000000);
+}
@@ -1,3 +1,9 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <string>
+#include <type_traits>
+#include <vector>
 #include "TextBuffer.hpp"
 #include "unit_test_framework.hpp"
 
@@ -10,4 +16,655 @@ TEST(test_stub) {
     ASSERT_TRUE(true);
 }
 
+// Positions must be wide enough for buffers and rows beyond 4 GiB.
+static_assert(sizeof(TextBuffer::Position) >= 8,
+              "TextBuffer positions must be 64 bits wide");
+static_assert(std::is_same<decltype(TextBuffer().size()),
+                           TextBuffer::Position>::value,
+              "size() must return a 64-bit position");
+
+// Inserts every character of str at the cursor.
+static void insert_string(TextBuffer &buffer, const string &str) {
+  for (char c : str) {
+    buffer.insert(c);
+  }
+}
+
+TEST(test_long_rows) {
+  // a few very long rows, the shape of a huge single-line dump
+  const TextBuffer::Position LENGTH = 1 << 20;
+  TextBuffer buffer;
+  string row(LENGTH, 'x');
+  insert_string(buffer, row + '\n' + row + '\n' + row);
+  ASSERT_EQUAL(buffer.size(), 3 * LENGTH + 2);
+  ASSERT_EQUAL(buffer.get_row(), 3);
+  ASSERT_EQUAL(buffer.get_column(), LENGTH);
+  ASSERT_EQUAL(buffer.get_index(), 3 * LENGTH + 2);
+
+  ASSERT_TRUE(buffer.up());
+  ASSERT_EQUAL(buffer.get_row(), 2);
+  ASSERT_EQUAL(buffer.get_column(), LENGTH);
+  ASSERT_EQUAL(buffer.data_at_cursor(), '\n');
+  buffer.move_to_column(LENGTH - 1);
+  ASSERT_EQUAL(buffer.get_index(), 2 * LENGTH);
+  ASSERT_TRUE(buffer.up());
+  ASSERT_EQUAL(buffer.get_index(), LENGTH - 1);
+  buffer.move_to_row_start();
+  ASSERT_EQUAL(buffer.get_index(), 0);
+  buffer.move_to_row_end();
+  ASSERT_EQUAL(buffer.get_column(), LENGTH);
+  ASSERT_TRUE(buffer.down());
+  ASSERT_TRUE(buffer.down());
+  ASSERT_EQUAL(buffer.get_row(), 3);
+  ASSERT_FALSE(buffer.down());
+
+  // round trip through stringify(), as femto does when saving
+  ASSERT_EQUAL(buffer.stringify(), row + '\n' + row + '\n' + row);
+}
+
+TEST(test_bulk_insert) {
+  const string text = "ab\ncde\n\nfghij";
+  TextBuffer single, bulk;
+  insert_string(single, "xy\nz");
+  insert_string(bulk, "xy\nz");
+  single.backward();
+  bulk.backward();
+
+  insert_string(single, text);
+  bulk.insert(text.data(), text.size());
+  ASSERT_EQUAL(bulk.stringify(), single.stringify());
+  ASSERT_EQUAL(bulk.get_row(), single.get_row());
+  ASSERT_EQUAL(bulk.get_column(), single.get_column());
+  ASSERT_EQUAL(bulk.get_index(), single.get_index());
+  ASSERT_EQUAL(bulk.data_at_cursor(), 'z');
+
+  // no newlines: only the column moves
+  bulk.insert("klm", 3);
+  ASSERT_EQUAL(bulk.get_row(), 5);
+  ASSERT_EQUAL(bulk.get_column(), 8);
+  bulk.insert("", 0);
+  ASSERT_EQUAL(bulk.get_column(), 8);
+  ASSERT_EQUAL(bulk.size(), single.size() + 3);
+}
+
+TEST(test_codepoint_columns) {
+  // "aé中\n😀b" - 1, 2, 3 and 4 byte sequences
+  const string text = "a\xC3\xA9\xE4\xB8\xAD\n\xF0\x9F\x98\x80" "b";
+  TextBuffer buffer;
+  buffer.set_column_mode(TextBuffer::CODEPOINTS);
+  insert_string(buffer, text);
+  ASSERT_EQUAL(buffer.get_row(), 2);
+  ASSERT_EQUAL(buffer.get_column(), 2);
+  ASSERT_EQUAL(buffer.get_index(), 12);
+
+  ASSERT_TRUE(buffer.backward());
+  ASSERT_EQUAL(buffer.data_at_cursor(), 'b');
+  ASSERT_TRUE(buffer.backward());
+  ASSERT_EQUAL(buffer.character_at_cursor(), "\xF0\x9F\x98\x80");
+  ASSERT_EQUAL(buffer.get_column(), 0);
+  ASSERT_EQUAL(buffer.get_index(), 7);
+  ASSERT_TRUE(buffer.up());
+  ASSERT_EQUAL(buffer.get_index(), 0);
+  buffer.move_to_row_end();
+  ASSERT_EQUAL(buffer.get_column(), 3);
+  buffer.move_to_column(2);
+  ASSERT_EQUAL(buffer.character_at_cursor(), "\xE4\xB8\xAD");
+  ASSERT_EQUAL(buffer.get_index(), 3);
+  ASSERT_TRUE(buffer.down());
+  ASSERT_EQUAL(buffer.get_column(), 2);
+  ASSERT_TRUE(buffer.is_at_end());
+
+  // removal takes the whole character
+  buffer.up();
+  buffer.move_to_column(1);
+  ASSERT_TRUE(buffer.remove());
+  ASSERT_EQUAL(buffer.stringify(),
+               "a\xE4\xB8\xAD\n\xF0\x9F\x98\x80" "b");
+  ASSERT_EQUAL(buffer.get_column(), 1);
+  ASSERT_EQUAL(buffer.character_at_cursor(), "\xE4\xB8\xAD");
+
+  // the same text counts bytes in BYTES mode
+  buffer.set_column_mode(TextBuffer::BYTES);
+  buffer.move_to_row_end();
+  ASSERT_EQUAL(buffer.get_column(), 4);
+}
+
+TEST(test_codepoint_bulk_insert) {
+  const string text = "x\xC3\xA9y\n\xE4\xB8\xAD\xE4\xB8\xADz";
+  TextBuffer single, bulk;
+  single.set_column_mode(TextBuffer::CODEPOINTS);
+  bulk.set_column_mode(TextBuffer::CODEPOINTS);
+  insert_string(single, text);
+  bulk.insert(text.data(), text.size());
+  ASSERT_EQUAL(bulk.get_row(), single.get_row());
+  ASSERT_EQUAL(bulk.get_column(), 3);
+  ASSERT_EQUAL(single.get_column(), 3);
+  bulk.insert("\xC3\xA9", 2);
+  ASSERT_EQUAL(bulk.get_column(), 4);
+}
+
+TEST(test_codepoint_invalid_sequences) {
+  // stray continuation bytes at the start of a row form a character
+  TextBuffer buffer;
+  buffer.set_column_mode(TextBuffer::CODEPOINTS);
+  insert_string(buffer, "z\n\x80\x80" "a");
+  ASSERT_EQUAL(buffer.get_column(), 2);
+  buffer.move_to_row_start();
+  ASSERT_EQUAL(buffer.character_at_cursor(), "\x80\x80");
+  ASSERT_TRUE(buffer.forward());
+  ASSERT_EQUAL(buffer.data_at_cursor(), 'a');
+  ASSERT_EQUAL(buffer.get_column(), 1);
+
+  // joining rows makes them continue the previous character
+  buffer.move_to_row_start();
+  ASSERT_TRUE(buffer.backward());
+  ASSERT_TRUE(buffer.remove());
+  ASSERT_EQUAL(buffer.data_at_cursor(), 'a');
+  ASSERT_EQUAL(buffer.get_row(), 1);
+  ASSERT_EQUAL(buffer.get_column(), 1);
+  ASSERT_EQUAL(buffer.get_index(), 3);
+  buffer.backward();
+  ASSERT_EQUAL(buffer.character_at_cursor(), "z\x80\x80");
+  ASSERT_EQUAL(buffer.get_index(), 0);
+}
+
+// Returns whether the byte at position i of text starts a character.
+static bool starts_character(const string &text, size_t i,
+                             TextBuffer::ColumnMode mode) {
+  return mode == TextBuffer::BYTES || i == 0 || i == text.size()
+    || (text[i] & 0xC0) != 0x80 || text[i - 1] == '\n';
+}
+
+// Checks the position and statistics of the buffer against values
+// computed directly from its contents.
+static void check_against_contents(const TextBuffer &buffer) {
+  TextBuffer::ColumnMode mode = buffer.get_column_mode();
+  string text = buffer.stringify();
+  size_t index = buffer.get_index();
+  ASSERT_TRUE(starts_character(text, index, mode));
+
+  vector<TextBuffer::Position> lengths = { 0 };
+  TextBuffer::Position row = 1, column = 0, characters = 0, words = 0;
+  bool in_word = false;
+  for (size_t i = 0; i < text.size(); ++i) {
+    bool word = !isspace(static_cast<unsigned char>(text[i]));
+    words += word && !in_word;
+    in_word = word;
+    if (text[i] == '\n') {
+      lengths.push_back(0);
+      ++characters;
+    } else if (starts_character(text, i, mode)) {
+      ++lengths.back();
+      ++characters;
+    }
+    if (i + 1 == index) {
+      row = lengths.size();
+      column = lengths.back();
+    }
+  }
+  ASSERT_EQUAL(buffer.get_row(), row);
+  ASSERT_EQUAL(buffer.get_column(), column);
+  ASSERT_EQUAL(buffer.row_count(), lengths.size());
+  ASSERT_EQUAL(buffer.char_count(), characters);
+  ASSERT_EQUAL(buffer.word_count(), words);
+  ASSERT_EQUAL(buffer.longest_row_length(),
+               *max_element(lengths.begin(), lengths.end()));
+  for (size_t r = 1; r <= lengths.size(); ++r) {
+    ASSERT_EQUAL(buffer.row_length(r), lengths[r - 1]);
+  }
+}
+
+// Applies random edits and motions, checking the buffer after each.
+static void check_random_edits(TextBuffer::ColumnMode mode) {
+  const string pieces[] = { "a", "b", " ", "\n", "\xC3\xA9", "\x80",
+                            "\xE4\xB8\xAD", "xy z\n\nw", "\n\x80q",
+                            "\t" };
+  srand(280);
+  TextBuffer buffer;
+  buffer.set_column_mode(mode);
+  for (int step = 0; step < 3000; ++step) {
+    switch (rand() % 9) {
+    case 0: case 1: {
+      const string &piece = pieces[rand() % 10];
+      buffer.insert(piece.data(), piece.size());
+      break;
+    }
+    case 2: insert_string(buffer, pieces[rand() % 10]); break;
+    case 3: buffer.remove(); break;
+    case 4: buffer.backward(); break;
+    case 5: buffer.forward(); break;
+    case 6: rand() % 2 ? buffer.up() : buffer.down(); break;
+    case 7: buffer.move_to_column(rand() % 6); break;
+    default:
+      rand() % 2 ? buffer.move_to_row_start() : buffer.move_to_row_end();
+    }
+    check_against_contents(buffer);
+  }
+}
+
+TEST(test_statistics_random_edits_bytes) {
+  check_random_edits(TextBuffer::BYTES);
+}
+
+TEST(test_statistics_random_edits_codepoints) {
+  check_random_edits(TextBuffer::CODEPOINTS);
+}
+
+TEST(test_statistics) {
+  TextBuffer buffer;
+  ASSERT_EQUAL(buffer.row_count(), 1);
+  ASSERT_EQUAL(buffer.row_length(1), 0);
+  ASSERT_EQUAL(buffer.word_count(), 0);
+  ASSERT_EQUAL(buffer.longest_row_length(), 0);
+  insert_string(buffer, "one two\nthree\n\nfour five six");
+  ASSERT_EQUAL(buffer.row_count(), 4);
+  ASSERT_EQUAL(buffer.row_length(2), 5);
+  ASSERT_EQUAL(buffer.row_length(3), 0);
+  ASSERT_EQUAL(buffer.char_count(), buffer.size());
+  ASSERT_EQUAL(buffer.word_count(), 6);
+  ASSERT_EQUAL(buffer.longest_row_length(), 13);
+
+  // joining rows and words
+  buffer.up();
+  buffer.up();
+  buffer.move_to_row_end();
+  buffer.remove();
+  ASSERT_EQUAL(buffer.row_count(), 3);
+  ASSERT_EQUAL(buffer.row_length(2), 5);
+  buffer.backward();
+  buffer.backward();
+  buffer.move_to_row_start();
+  buffer.backward();
+  buffer.remove();
+  ASSERT_EQUAL(buffer.word_count(), 5);
+  ASSERT_EQUAL(buffer.longest_row_length(), 13);
+  ASSERT_EQUAL(buffer.stringify(), "one twothree\nfour five six");
+}
+
+TEST(test_down_keeps_column) {
+  TextBuffer buffer;
+  insert_string(buffer, "0123456789\n0123456789");
+  buffer.up();
+  buffer.move_to_column(3);
+  ASSERT_TRUE(buffer.down());
+  ASSERT_EQUAL(buffer.get_row(), 2);
+  ASSERT_EQUAL(buffer.get_column(), 3);
+  ASSERT_FALSE(buffer.down()); // does nothing in the last row
+  ASSERT_EQUAL(buffer.get_column(), 3);
+}
+
+// Returns the row containing the byte at index in text.
+static TextBuffer::Position row_at(const string &text,
+                                   TextBuffer::Position index) {
+  return 1 + count(text.begin(), text.begin() + index, '\n');
+}
+
+TEST(test_observer_edits) {
+  TextBuffer buffer;
+  vector<TextBuffer::Edit> edits;
+  int id = buffer.subscribe([&](const TextBuffer::Edit &edit) {
+    edits.push_back(edit);
+  });
+  buffer.insert("ab\ncd", 5);
+  buffer.insert('e');
+  ASSERT_EQUAL(edits.size(), 2u);
+  ASSERT_EQUAL(edits[0].index, 0);
+  ASSERT_EQUAL(edits[0].removed, 0);
+  ASSERT_EQUAL(edits[0].inserted, "ab\ncd");
+  ASSERT_EQUAL(edits[0].first_row, 1);
+  ASSERT_EQUAL(edits[0].last_row, 2);
+  ASSERT_EQUAL(edits[1].index, 5);
+  ASSERT_EQUAL(edits[1].inserted, "e");
+
+  buffer.up();
+  buffer.move_to_row_end();
+  buffer.remove(); // the newline
+  ASSERT_EQUAL(edits.size(), 3u);
+  ASSERT_EQUAL(edits[2].index, 2);
+  ASSERT_EQUAL(edits[2].removed, 1);
+  ASSERT_EQUAL(edits[2].inserted, "");
+  ASSERT_EQUAL(edits[2].first_row, 1);
+  ASSERT_EQUAL(edits[2].last_row, 1);
+
+  buffer.unsubscribe(id);
+  buffer.insert('x');
+  ASSERT_EQUAL(edits.size(), 3u);
+}
+
+TEST(test_observer_codepoint_remove) {
+  TextBuffer buffer;
+  buffer.set_column_mode(TextBuffer::CODEPOINTS);
+  insert_string(buffer, "a\xE4\xB8\xAD" "b");
+  vector<TextBuffer::Edit> edits;
+  buffer.subscribe([&](const TextBuffer::Edit &edit) {
+    edits.push_back(edit);
+  });
+  buffer.move_to_column(1);
+  buffer.remove(); // all three bytes of the character
+  ASSERT_EQUAL(edits.size(), 1u);
+  ASSERT_EQUAL(edits[0].index, 1);
+  ASSERT_EQUAL(edits[0].removed, 3);
+}
+
+TEST(test_batched_edits) {
+  srand(7);
+  const string pieces[] = { "a", "b c", "\n", "xy\nz\n", "  " };
+  TextBuffer buffer;
+  insert_string(buffer, "first row\nsecond row\nthird row");
+  vector<TextBuffer::Edit> edits;
+  buffer.subscribe([&](const TextBuffer::Edit &edit) {
+    edits.push_back(edit);
+  });
+  for (int batch = 0; batch < 200; ++batch) {
+    string before = buffer.stringify();
+    edits.clear();
+    buffer.begin_batch();
+    buffer.begin_batch(); // nested batches notify once
+    for (int step = 0; step < 6; ++step) {
+      switch (rand() % 6) {
+      case 0: buffer.forward(); break;
+      case 1: buffer.backward(); break;
+      case 2: buffer.up(); break;
+      case 3: buffer.down(); break;
+      case 4: insert_string(buffer, pieces[rand() % 5]); break;
+      default: buffer.remove(); break;
+      }
+    }
+    buffer.end_batch();
+    ASSERT_TRUE(edits.empty());
+    buffer.end_batch();
+    string after = buffer.stringify();
+    if (edits.empty()) {
+      ASSERT_EQUAL(after, before);
+      continue;
+    }
+    ASSERT_EQUAL(edits.size(), 1u);
+    const TextBuffer::Edit &edit = edits[0];
+    ASSERT_EQUAL(before.replace(edit.index, edit.removed, edit.inserted),
+                 after);
+    ASSERT_EQUAL(edit.first_row, row_at(after, edit.index));
+    ASSERT_EQUAL(edit.last_row,
+                 row_at(after, edit.index + edit.inserted.size()));
+  }
+}
+
+TEST(test_move_to_index) {
+  TextBuffer buffer;
+  buffer.set_column_mode(TextBuffer::CODEPOINTS);
+  string text = "ab\n\xC3\xA9x\n\nlast";
+  buffer.insert(text.data(), text.size());
+  buffer.move_to_index(4); // inside the two-byte character
+  ASSERT_EQUAL(buffer.get_index(), 3);
+  ASSERT_EQUAL(buffer.get_row(), 2);
+  ASSERT_EQUAL(buffer.get_column(), 0);
+  buffer.move_to_index(5);
+  ASSERT_EQUAL(buffer.get_column(), 1);
+  ASSERT_EQUAL(buffer.data_at_cursor(), 'x');
+  buffer.move_to_index(1);
+  ASSERT_EQUAL(buffer.get_row(), 1);
+  ASSERT_EQUAL(buffer.get_column(), 1);
+  buffer.move_to_index(buffer.size());
+  ASSERT_TRUE(buffer.is_at_end());
+  ASSERT_EQUAL(buffer.get_row(), 4);
+  ASSERT_EQUAL(buffer.get_column(), 4);
+  buffer.move_to_index(7);
+  ASSERT_EQUAL(buffer.get_row(), 3);
+  ASSERT_EQUAL(buffer.get_column(), 0);
+}
+
+TEST(test_move_to_index_ahead_in_row) {
+  const string pieces[] = { "ab", " ", "\xC3\xA9", "\xE4\xB8\xAD", "\x80" };
+  srand(35);
+  string text;
+  for (int i = 0; i < 2000; ++i) {
+    text += pieces[rand() % 5];
+  }
+  TextBuffer::Position row_end = text.size();
+  text += "\nlast";
+  for (auto mode : { TextBuffer::BYTES, TextBuffer::CODEPOINTS }) {
+    TextBuffer buffer;
+    buffer.set_column_mode(mode);
+    buffer.insert(text.data(), text.size());
+    TextBuffer expected;
+    expected.set_column_mode(mode);
+    expected.insert(text.data(), text.size());
+    buffer.move_to_index(0);
+    for (TextBuffer::Position index = 0; index <= row_end;
+         index += rand() % 9) {
+      // the same position as moving there from the next row
+      buffer.move_to_index(index);
+      expected.move_to_index(text.size());
+      expected.move_to_index(index);
+      ASSERT_EQUAL(buffer.get_row(), 1);
+      ASSERT_EQUAL(buffer.get_column(), expected.get_column());
+      ASSERT_EQUAL(buffer.get_index(), expected.get_index());
+    }
+    check_against_contents(buffer);
+  }
+}
+
+TEST(test_move_to_row) {
+  TextBuffer buffer;
+  string text;
+  for (int i = 0; i < 50; ++i) {
+    text += string(i % 7 * 3, 'a' + i % 26) + "\n";
+  }
+  buffer.insert(text.data(), text.size());
+  srand(48);
+  for (int step = 0; step < 500; ++step) {
+    TextBuffer::Position row = 1 + rand() % buffer.row_count();
+    TextBuffer::Position column = rand() % 20;
+    // the same position as moving there a row at a time
+    TextBuffer expected;
+    expected.insert(text.data(), text.size());
+    expected.move_to_index(0);
+    while (expected.get_row() < row && expected.down());
+    expected.move_to_column(column);
+    buffer.move_to_row(row, column);
+    ASSERT_EQUAL(buffer.get_row(), row);
+    ASSERT_EQUAL(buffer.get_column(), expected.get_column());
+    ASSERT_EQUAL(buffer.get_index(), expected.get_index());
+    check_against_contents(buffer);
+  }
+}
+
+// Skips over random classes of characters from random positions,
+// checking against moving a character at a time.
+static void check_random_skips(TextBuffer::ColumnMode mode) {
+  const string pieces[] = { "ab c", "\n", "\xC3\xA9", "\x80", "x\n\ny ",
+                            "\xE4\xB8\xAD\n", "\x80\x80z" };
+  srand(50);
+  string text;
+  for (int i = 0; i < 300; ++i) {
+    text += pieces[rand() % 7];
+  }
+  TextBuffer buffer;
+  buffer.set_column_mode(mode);
+  buffer.insert(text.data(), text.size());
+  TextBuffer expected;
+  expected.set_column_mode(mode);
+  expected.insert(text.data(), text.size());
+  for (int step = 0; step < 1000; ++step) {
+    TextBuffer::ByteClass byte_class;
+    for (int c = 0; c < 256; ++c) {
+      byte_class[c] = rand() % 4 != 0;
+    }
+    TextBuffer::Position index = rand() % (text.size() + 1);
+    buffer.move_to_index(index);
+    expected.move_to_index(index);
+    bool moved = false;
+    if (rand() % 2) {
+      while (!expected.is_at_end()
+             && byte_class[static_cast<unsigned char>(
+                  expected.data_at_cursor())]) {
+        moved = expected.forward();
+      }
+      ASSERT_EQUAL(buffer.skip_forward_while(byte_class), moved);
+    } else {
+      while (expected.backward()) {
+        if (!byte_class[static_cast<unsigned char>(
+              expected.data_at_cursor())]) {
+          expected.forward();
+          break;
+        }
+        moved = true;
+      }
+      ASSERT_EQUAL(buffer.skip_backward_while(byte_class), moved);
+    }
+    ASSERT_EQUAL(buffer.get_index(), expected.get_index());
+    ASSERT_EQUAL(buffer.get_row(), expected.get_row());
+    ASSERT_EQUAL(buffer.get_column(), expected.get_column());
+    check_against_contents(buffer);
+  }
+}
+
+TEST(test_skip_while_bytes) {
+  check_random_skips(TextBuffer::BYTES);
+}
+
+TEST(test_skip_while_codepoints) {
+  check_random_skips(TextBuffer::CODEPOINTS);
+}
+
+// Erases random ranges ending at character boundaries, checking the
+// buffer and the single edit reported after each.
+static void check_random_erases(TextBuffer::ColumnMode mode) {
+  const string pieces[] = { "ab c", "\n", "\xC3\xA9", "\x80", "x\n\ny ",
+                            "\xE4\xB8\xAD\n" };
+  srand(35);
+  TextBuffer buffer;
+  buffer.set_column_mode(mode);
+  vector<TextBuffer::Edit> edits;
+  buffer.subscribe([&](const TextBuffer::Edit &edit) {
+    edits.push_back(edit);
+  });
+  for (int step = 0; step < 2000; ++step) {
+    const string &piece = pieces[rand() % 6];
+    buffer.insert(piece.data(), piece.size());
+    if (rand() % 2) {
+      buffer.move_to_index(rand() % (buffer.size() + 1));
+    }
+    string before = buffer.stringify();
+    size_t index = buffer.get_index();
+    size_t end = min(before.size(), index + rand() % 12);
+    while (!starts_character(before, end, mode)) {
+      ++end;
+    }
+    edits.clear();
+    buffer.erase(end - index);
+    check_against_contents(buffer);
+    ASSERT_EQUAL(buffer.stringify(), before.erase(index, end - index));
+    ASSERT_EQUAL(edits.size(), static_cast<size_t>(end > index));
+  }
+}
+
+TEST(test_erase_random_bytes) {
+  check_random_erases(TextBuffer::BYTES);
+}
+
+TEST(test_erase_random_codepoints) {
+  check_random_erases(TextBuffer::CODEPOINTS);
+}
+
+TEST(test_cut) {
+  const string text = "one\ntwo \xC3\xA9\n\nthree";
+  TextBuffer buffer;
+  buffer.set_column_mode(TextBuffer::CODEPOINTS);
+  buffer.insert(text.data(), text.size());
+  buffer.move_to_index(4);
+  string cut = "<";
+  buffer.cut(7, cut); // "two \xC3\xA9\n"
+  buffer.cut(1, cut); // "\n"
+  buffer.cut(0, cut);
+  ASSERT_EQUAL(cut, "<two \xC3\xA9\n\n");
+  ASSERT_EQUAL(buffer.stringify(), "one\nthree");
+  ASSERT_EQUAL(buffer.get_row(), 2);
+  ASSERT_EQUAL(buffer.get_column(), 0);
+  check_against_contents(buffer);
+  buffer.insert(cut.data() + 1, cut.size() - 1);
+  ASSERT_EQUAL(buffer.stringify(), text);
+  ASSERT_EQUAL(buffer.get_row(), 4);
+  check_against_contents(buffer);
+}
+
+TEST(test_append) {
+  for (TextBuffer::ColumnMode mode : { TextBuffer::BYTES,
+                                       TextBuffer::CODEPOINTS }) {
+    TextBuffer buffer;
+    buffer.set_column_mode(mode);
+    string text = "ab\nc\xC3";
+    buffer.append(text.data(), text.size());
+    ASSERT_EQUAL(buffer.get_index(), 0); // the cursor was at the end
+    check_against_contents(buffer);
+    buffer.move_to_index(buffer.size());
+    buffer.append("\xA9\n", 2); // finishes the last character
+    text += "\xA9\n";
+    ASSERT_EQUAL(buffer.stringify(), text);
+    // in CODEPOINTS mode, the cursor moves past the rest of "\xC3\xA9"
+    ASSERT_EQUAL(buffer.get_index(), mode == TextBuffer::BYTES ? 5 : 6);
+    ASSERT_EQUAL(buffer.get_row(), 2);
+    check_against_contents(buffer);
+    buffer.move_to_index(1);
+    buffer.append("x\n\ny", 4);
+    text += "x\n\ny";
+    ASSERT_EQUAL(buffer.stringify(), text);
+    ASSERT_EQUAL(buffer.get_index(), 1);
+    ASSERT_EQUAL(buffer.data_at_cursor(), 'b');
+    check_against_contents(buffer);
+    buffer.insert('z');
+    text.insert(1, "z");
+    ASSERT_EQUAL(buffer.stringify(), text);
+    check_against_contents(buffer);
+  }
+}
+
+TEST(test_reader) {
+  for (TextBuffer::ColumnMode mode : { TextBuffer::BYTES,
+                                       TextBuffer::CODEPOINTS }) {
+    TextBuffer buffer;
+    buffer.set_column_mode(mode);
+    string text = "ab\n\n\xC3\xA9t\xE4\xB8\xAD\n\xA9x\nlast";
+    buffer.insert(text.data(), text.size());
+    buffer.move_to_index(4); // the reader does not depend on the cursor
+
+    // reading from the first row visits what the cursor would
+    TextBuffer::Reader reader = buffer.reader_at_row(1);
+    TextBuffer cursor;
+    cursor.set_column_mode(mode);
+    cursor.insert(text.data(), text.size());
+    cursor.move_to_index(0);
+    while (!cursor.is_at_end()) {
+      ASSERT_FALSE(reader.is_at_end());
+      ASSERT_EQUAL(reader.get_index(), cursor.get_index());
+      ASSERT_EQUAL(reader.get_row(), cursor.get_row());
+      ASSERT_EQUAL(reader.get_column(), cursor.get_column());
+      ASSERT_EQUAL(reader.data(), cursor.data_at_cursor());
+      ASSERT_EQUAL(reader.character(), cursor.character_at_cursor());
+      ASSERT_TRUE(reader.forward());
+      cursor.forward();
+    }
+    ASSERT_TRUE(reader.is_at_end());
+    ASSERT_EQUAL(reader.get_index(), buffer.size());
+    ASSERT_FALSE(reader.forward());
+    ASSERT_EQUAL(buffer.get_index(), 4);
+
+    // each row can be reached directly, or from the one before
+    TextBuffer::Reader next = buffer.reader_at_row(1);
+    next.forward(); // next_row() works from within a row
+    for (TextBuffer::Position row = 1; row <= buffer.row_count(); ++row) {
+      TextBuffer::Reader start = buffer.reader_at_row(row);
+      cursor.move_to_index(start.get_index());
+      ASSERT_EQUAL(cursor.get_row(), row);
+      ASSERT_EQUAL(cursor.get_column(), 0);
+      ASSERT_EQUAL(start.get_column(), 0);
+      if (row > 1) {
+        ASSERT_EQUAL(next.get_index(), start.get_index());
+        ASSERT_EQUAL(next.get_row(), row);
+      }
+      ASSERT_EQUAL(next.next_row(), row < buffer.row_count());
+    }
+    ASSERT_EQUAL(buffer.reader_at_row(5).character(), "l");
+  }
+}
+
 TEST_MAIN()
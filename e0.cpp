@@ -45,8 +45,9 @@ void render_buf(TextBuffer &buffer, WINDOW *window) {
   werase(window);
 
   std::string data = buffer.stringify();
-  int cursor = buffer.get_index();
-  for (int i = 0; i < static_cast<int>(data.size()); ++i) {
+  TextBuffer::Position cursor = buffer.get_index();
+  for (TextBuffer::Position i = 0;
+       i < static_cast<TextBuffer::Position>(data.size()); ++i) {
     char c = data[i];
     // The display character is either ' ' (if it's a newline) or the char
     // The display character is what gets highlighted if we're at the point
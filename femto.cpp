@@ -9,15 +9,35 @@
  */
 
 #include <algorithm>
+#include <array>
+#include <cctype>
 #include <chrono>
+#include <clocale>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
-#include <deque>
 #include <iostream>
 #include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
+#include <langinfo.h>
 #include <ncurses.h>
+#include <poll.h>
+#include <unistd.h>
+#include "AtomicFile.hpp"
+#include "Autosaver.hpp"
+#include "CharScan.hpp"
+#include "CharWidth.hpp"
+#include "FileLoader.hpp"
+#include "Journal.hpp"
+#include "MappedFile.hpp"
+#include "MatchIndex.hpp"
+#include "Regex.hpp"
+#include "Search.hpp"
 #include "TextBuffer.hpp"
 
 #ifndef FEMTO_INPUT_MODE // default to terminal input mode
@@ -28,21 +48,75 @@ class FemtoEditor {
 public:
   static constexpr const char *version = "2.80";
 
+  // default sizes from which a file is edited in large-file mode
+  static constexpr std::int64_t LARGE_FILE_BYTES = 64 << 20;
+  static constexpr TextBuffer::Position LARGE_FILE_ROWS = 1000000;
+
+  // default largest number of frames rendered per second
+  static const int FRAME_RATE = 60;
+
   enum InputMode {
     TERMINAL, // terminal interprets control keys
     RAW       // control keys are passed uninterpreted to FEMTO
   };
 
   // Initialize the editor with the given file and input mode.
-  // Starts the interaction.
-  FemtoEditor(std::string filename_in, InputMode input_mode_in)
+  // Starts the interaction. Text is treated as UTF-8 if the locale's
+  // character set is UTF-8. If map_file is true, the file is mapped
+  // into memory and read only as far as it is viewed or searched. If
+  // the journal holds edits to the file that were never saved, offers
+  // to recover them. A file of at least large_bytes_in bytes or
+  // large_rows_in lines is edited in large-file mode, which shows
+  // approximate positions. If debug_overlay_in is true, the number of
+  // rows rendered and bytes sent to the terminal are shown. Input typed
+  // or pasted ahead is handled before the screen is rendered, which is
+  // rendered at most frame_rate_in times a second, or as often as
+  // input allows if it is 0.
+  FemtoEditor(std::string filename_in, InputMode input_mode_in,
+              bool map_file = false,
+              std::int64_t large_bytes_in = LARGE_FILE_BYTES,
+              TextBuffer::Position large_rows_in = LARGE_FILE_ROWS,
+              bool debug_overlay_in = false,
+              int frame_rate_in = FRAME_RATE)
     : baseline(1), cursor_row(1), filename(filename_in),
       modified(false), percentage(0), status("initial"),
-      input_mode(input_mode_in) {
-    if (!filename.empty()) {
-      read_file();
+      regex_search(false), matches(editbuffer.text), loaded(0),
+      autosaver(editbuffer.text),
+      journal(editbuffer.text, filename_in), recovering(false),
+      large_bytes(large_bytes_in), large_rows(large_rows_in),
+      large_file(false), canvas_damaged(true), dirty_first(1),
+      dirty_last(0), known_rows(1), drawn(), debug_overlay(debug_overlay_in),
+      rows_rendered(0), frame_rows(0), total_rows(0), frame_bytes(0),
+      total_bytes(0), frame_rate(frame_rate_in), last_frame(),
+      returned_keys(0),
+      input_mode(input_mode_in),
+      utf8(std::strcmp(nl_langinfo(CODESET), "UTF-8") == 0) {
+    if (utf8) {
+      editbuffer.text.set_column_mode(TextBuffer::CODEPOINTS);
+      minibuffer.text.set_column_mode(TextBuffer::CODEPOINTS);
+    }
+    // an edit changes the rows it spans, and moves the rows after it
+    // if it adds or removes lines
+    editbuffer.text.subscribe([this](const TextBuffer::Edit &edit) {
+      Position rows = editbuffer.text.row_count();
+      damage_rows(edit.first_row, rows == known_rows ? edit.last_row
+                  : std::numeric_limits<Position>::max());
+      known_rows = rows;
+    });
+    std::string base;
+    bool recoverable = Journal::is_recoverable(filename, base);
+    if (!recoverable) {
+      open_file(filename, map_file);
     }
     setup_windows();
+    if (recoverable) {
+      // the edits are replayed onto the whole base, before any new ones
+      recovering = handle_recover();
+      open_file(recovering ? base : filename, map_file && !recovering);
+      if (recovering) {
+        finish_loading();
+      }
+    }
     interact();
   }
 
@@ -53,13 +127,35 @@ public:
   // Shut down ncurses.
   ~FemtoEditor() {
     curs_set(visibility); // restore prior visibility
+    set_bracketed_paste(false);
     endwin();
   }
 
 private:
   using clock_t = std::chrono::steady_clock;
+  using Position = TextBuffer::Position;
   static constexpr double MESSAGE_TIMEOUT = 5; // time in seconds
+  // how often to check for the match index while it is computed. Each
+  // search copies the whole text for the worker, a slice at a time
+  // between checks for input (see MatchIndex::COPY_SIZE), and each edit
+  // then shifts every match after it.
+  static const int MATCH_POLL_MILLISECONDS = 50;
+  // how long to read the file for between checks for input
+  static constexpr int LOAD_SLICE_MILLISECONDS = 30;
   static const std::size_t MAX_SHORT_STRING_LENGTH = 20;
+  static constexpr char32_t INVALID_CODEPOINT = 0xFFFFFFFF;
+  static const int MAX_UTF8_CHAR = 255; // bytes of multibyte input
+  // bytes of input read at a time, which fit in the curses input queue
+  // when given back
+  static const std::size_t INPUT_CHUNK_SIZE = 64;
+  // most keys the curses input queue holds (FIFO_SIZE in ncurses): keys
+  // given back to it, and bytes it read ahead while matching a key
+  static const int CURSES_QUEUE_SIZE = 137;
+  // what the terminal sends around pasted text, and how long to wait
+  // for the rest of a paste
+  static constexpr const char *PASTE_START_SEQUENCE = "\x1b[200~";
+  static constexpr const char *PASTE_END_SEQUENCE = "\x1b[201~";
+  static const int PASTE_WAIT_MILLISECONDS = 1000;
 
   struct KeyBindings {
     static const int EXIT1 = 24; // ^X
@@ -70,7 +166,10 @@ private:
     static const int REFRESH = 12; // ^L
     static const int FIND1 = 6; // ^F
     static const int FIND2 = 23; // ^W - pico/nano binding
+    static const int FIND_BACKWARD = 18; // ^R - emacs binding
+    static const int REGEX_TOGGLE = 20; // ^T - in the find prompt
     static const int GOTO = 7; // ^G
+    static const int REPLACE = 5; // ^E
     static const int CUT = 11; // ^K
     static const int UNCUT = 21; // ^U
     static const int CANCEL = 14; // ^N
@@ -91,6 +190,8 @@ private:
     static const int PAGE_UP = 567; // ^up on Windows
     static const int IGNORE1 = -1; // sent when mucking with the window
     static const int IGNORE2 = 410; // sent when mucking with the window
+    static const int PASTE_START = KEY_MAX + 1; // bracketed paste, as
+    static const int PASTE_END = KEY_MAX + 2;   // defined in setup
     static const int MIN_CHAR = 1;
     static const int MAX_CHAR = 126;
 
@@ -109,6 +210,15 @@ private:
     static constexpr bool is_find(int c) {
       return c == FIND1 || c == FIND2;
     }
+    static constexpr bool is_find_backward(int c) {
+      return c == FIND_BACKWARD;
+    }
+    static constexpr bool is_replace(int c) {
+      return c == REPLACE;
+    }
+    static constexpr bool is_regex_toggle(int c) {
+      return c == REGEX_TOGGLE;
+    }
     static constexpr bool is_cut(int c) {
       return c == CUT;
     }
@@ -159,8 +269,11 @@ private:
     static constexpr bool is_word_right(int c) {
       return c == WORD_RIGHT1 || c == WORD_RIGHT2 || c == WORD_RIGHT3;
     }
+    static constexpr bool is_paste(int c) {
+      return c == PASTE_START;
+    }
     static constexpr bool is_ignore(int c) {
-      return c == IGNORE1 || c == IGNORE2;
+      return c == IGNORE1 || c == IGNORE2 || c == PASTE_END;
     }
   };
 
@@ -170,8 +283,8 @@ private:
     bool reverse;        // whether A_REVERSE is set on the window
     std::string long_prefix; // prefix string before placing characters
     std::string short_prefix; // shorter prefix for narrow windows
-    int view_row;        // cursor row
-    int view_column;     // first text column to show in cursor row
+    Position view_row;    // cursor row
+    Position view_column; // first text column to show in cursor row
     char left_overflow_marker;
     char right_overflow_marker;
 
@@ -198,8 +311,8 @@ private:
     // Compute the new view column based on the cursor and move the
     // text buffer to that position.
     // REQUIRES: femto.text.get_row() == cursor_row
-    void recompute_view_column(FemtoEditor &femto, int cursor_row,
-                               int cursor_column) {
+    void recompute_view_column(FemtoEditor &femto, Position cursor_row,
+                               Position cursor_column) {
       if (cursor_row != view_row || cursor_column < view_column) {
         view_row = cursor_row;
         view_column = 0; // recompute from the left
@@ -213,22 +326,23 @@ private:
              && !text.is_at_end() // handle end of buffer
              && text.get_row() == cursor_row; // handle end of row
            text.forward()) {
-        char c = text.data_at_cursor();
+        std::string c = text.character_at_cursor();
         window_column += femto.display_width(window_column, c);
-        if (window_column > window_width && c != '\n') {
+        if (window_column > window_width && c != "\n") {
           // slide view column to the right
           window_width = getmaxx(window) - prefix.size() -  1;
           int remaining = window_width - 1; //right overflow marker
           // max of current char + 4 chars to the left of current
-          for (int i = 0, ichar = text.data_at_cursor();
-               i < 5 && remaining - femto.display_width(0, ichar) >= 0;
-               remaining -= femto.display_width(0, ichar), ++i,
-                 text.backward(), ichar = text.data_at_cursor());
+          for (int i = 0, width = femto.display_width(0, c);
+               i < 5 && remaining - width >= 0;
+               remaining -= width, ++i, text.backward(),
+                 width = femto.display_width(0,
+                                             text.character_at_cursor()));
           text.forward(); // we went back too far by one character
           view_column = text.get_column();
           // set window column after current character
           window_column =
-            1 + femto.display_width(1, text.data_at_cursor());
+            1 + femto.display_width(1, text.character_at_cursor());
         }
       }
       if (text.get_row() != cursor_row) { // we moved to the next row
@@ -238,10 +352,30 @@ private:
     }
   };
 
+  // Result of an incremental search for a pattern: where it was found
+  // (-1 if nowhere) and whether the search wrapped around to get there.
+  struct SearchResult {
+    std::string pattern;
+    Position found;
+    bool wrapped;
+  };
+
+  // What the canvas shows, other than the text: the cursor, the rows
+  // and columns in view, and the matches highlighted.
+  struct CanvasState {
+    Position index;
+    Position row;
+    Position baseline;
+    Position view_column;
+    bool highlight;
+    bool matches_ready;
+    std::string pattern;
+  };
+
   Buffer editbuffer = {{}, nullptr, false, "", "", 1, 0, '$', '$'};
   Buffer minibuffer = {{}, nullptr, true, "", "", 1, 0, '<', '>'};
-  int baseline;         // row of top line in canvas
-  int cursor_row;
+  Position baseline;    // row of top line in canvas
+  Position cursor_row;
   std::string filename;
   bool modified;        // whether or not the text has been modified
   int percentage;       // how far in the text the cursor is
@@ -250,6 +384,32 @@ private:
   std::chrono::time_point<clock_t> message_time;
   std::string cut_value;
   std::string previous_search;
+  bool regex_search;    // whether find uses regular expressions
+  MatchIndex matches;   // occurrences of the last search, to highlight
+  std::unique_ptr<FileLoader> loader; // rest of the file, while it loads
+  std::unique_ptr<MappedFile> mapped; // rest of the file, until needed
+  std::int64_t loaded;  // bytes of the file added to the buffer
+  Autosaver autosaver;  // snapshots that the journal is compacted to
+  Journal journal;      // unsaved edits, for recovery
+  bool recovering;      // whether the journal is replayed once loaded
+  std::string journal_error; // the last journal error reported
+  std::int64_t large_bytes; // size from which a file is large
+  Position large_rows;  // number of lines from which a file is large
+  bool large_file;      // whether in large-file mode
+  bool canvas_damaged;  // whether the whole canvas must be drawn
+  Position dirty_first; // rows changed by edits since the canvas was
+  Position dirty_last;  // drawn, if dirty_first <= dirty_last
+  Position known_rows;  // number of rows after the last edit
+  CanvasState drawn;    // what the canvas was last drawn for
+  bool debug_overlay;   // whether to show the rendering counters
+  int rows_rendered;    // rows rendered since the last frame
+  int frame_rows;       // rows rendered for the last frame, and in all
+  std::int64_t total_rows;
+  std::int64_t frame_bytes; // bytes sent to the terminal for the last
+  std::int64_t total_bytes; // frame, and in all
+  int frame_rate;       // most frames rendered per second, if not 0
+  std::chrono::time_point<clock_t> last_frame; // when it was rendered
+  int returned_keys;    // keys given back to curses, to be read first
   WINDOW *main_window;
   WINDOW *canvas;
   WINDOW *top_bar;
@@ -257,8 +417,11 @@ private:
   WINDOW *message_bar;
   WINDOW *bottom_bar;
   bool input_mode;
+  bool utf8;            // whether text is UTF-8 encoded
   int visibility;
   int char_widths[256]; // onscreen width of each character
+  std::string char_escapes[256]; // how each character is shown
+  std::vector<chtype> row_cells; // row being batched for a window
 
   // Initial curses setup.
   // look the other way if you've ever programmed using curses
@@ -272,6 +435,10 @@ private:
     noecho();
     keypad(main_window, true);
     visibility = curs_set(0);
+    // the terminal marks pasted text, which is read as a whole
+    define_key(PASTE_START_SEQUENCE, KeyBindings::PASTE_START);
+    define_key(PASTE_END_SEQUENCE, KeyBindings::PASTE_END);
+    set_bracketed_paste(true);
 
     int ncols = getmaxx(main_window);
     int nlines = getmaxy(main_window);
@@ -289,11 +456,19 @@ private:
     bottom_bar = subwin(main_window, 1 /* lines */, ncols, nlines - 1, begx);
     editbuffer.window = canvas;
     minibuffer.window = bottom_bar;
+    idlok(canvas, true); // scroll the canvas in the terminal
     compute_character_widths();
+    canvas_damaged = true;
     render_all(highlight_canvas_cursor); // render everything
   }
 
-  // Compute onscreen character widths.
+  // Turn the terminal's bracketed paste mode on or off.
+  static void set_bracketed_paste(bool on) {
+    std::fputs(on ? "\x1b[?2004h" : "\x1b[?2004l", stdout);
+    std::fflush(stdout);
+  }
+
+  // Compute onscreen character widths and escapes.
   void compute_character_widths() {
     int x, y [[maybe_unused]];
     for (int i = 0; i <= KeyBindings::MAX_CHAR; ++i) {
@@ -313,10 +488,30 @@ private:
     // Special handling for backspace and delete
     char_widths[static_cast<unsigned char>('\b')] = 2;
     char_widths[static_cast<unsigned char>('\x7f')] = 2;
+
+    // Control characters are shown as ^ and a letter, as curses does,
+    // and remaining chars as a backslash and their octal value
+    for (int i = 0; i < 256; ++i) {
+      if (i <= KeyBindings::MAX_CHAR || i == '\x7f') {
+        char_escapes[i] = unctrl(i);
+      } else {
+        char buf[11];
+        std::snprintf(buf, sizeof(buf) / sizeof(char), "\\%o", i);
+        char_escapes[i] = buf;
+      }
+    }
   }
 
   // Render all windows.
   void render_all(bool highlight_canvas_cursor = true) {
+    // read as much of a mapped file as can be in view
+    load_rows(editbuffer.text.get_row() + getmaxy(canvas));
+    matches.poll();
+    if (!large_file && (file_bytes() >= large_bytes
+                        || editbuffer.text.row_count() >= large_rows)) {
+      large_file = true;
+    }
+    std::int64_t bytes = debug_overlay ? terminal_bytes() : 0;
     render_canvas(highlight_canvas_cursor);
     wrefresh(canvas);
     render_top_bars();
@@ -326,13 +521,321 @@ private:
     wrefresh(message_bar);
     render_bottom_bar();
     wrefresh(bottom_bar);
+    if (debug_overlay) {
+      // shown with the next frame
+      frame_rows = rows_rendered;
+      total_rows += rows_rendered;
+      rows_rendered = 0;
+      frame_bytes = terminal_bytes() - bytes;
+      total_bytes += frame_bytes;
+    }
+  }
+
+  // The number of bytes this thread has written, which while rendering
+  // are the bytes sent to the terminal.
+  static std::int64_t terminal_bytes() {
+    std::ifstream io("/proc/thread-self/io");
+    std::string field;
+    std::int64_t count = 0;
+    while (io >> field >> count && field != "wchar:");
+    return count;
   }
 
   // Main interaction loop -- respond to user input.
   void interact() {
-    do {
+    while (true) {
+      update_journal();
+      // handle all the input typed ahead before rendering, so that a
+      // paste is rendered once rather than once per character
+      timeout(0);
+      int c = read_key();
+      if (c == ERR) {
+        c = wait_for_input();
+      }
+      if (c == ERR && loader) {
+        load_blocks();
+      } else if (c == ERR && matches.copying()) {
+        matches.poll();
+      } else if (is_text_input(c)) {
+        handle_text_input(c);
+      } else {
+        timeout(-1); // commands that prompt wait for input
+        if (!handle_edit_input(c)) {
+          // the edits were saved or abandoned
+          autosaver.discard();
+          journal.stop();
+          return;
+        }
+      }
+    }
+  }
+
+  // Render the screen, unless a frame was rendered too recently, and
+  // wait for input. Returns the input, or ERR if there was none by the
+  // time the next frame, the file loading, the matches, the journal or
+  // its compaction needs attention.
+  int wait_for_input() {
+    int frame_wait = 0;
+    if (frame_rate > 0) {
+      auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        last_frame + std::chrono::milliseconds(1000 / frame_rate)
+        - clock_t::now()).count();
+      frame_wait = std::max<int>(0, remaining);
+    }
+    if (frame_wait == 0) {
       render_all();
-    } while (handle_edit_input(getch()));
+      last_frame = clock_t::now();
+    }
+    // keep loading the file or copying it for the matches while there
+    // is no input, and wake up to show the matches once they have been
+    // indexed, to sync the journal, or to compact it
+    int wait = loader || matches.copying() ? 0
+      : matches.pending() || autosaver.pending()
+      ? MATCH_POLL_MILLISECONDS : -1;
+    int journal_wait = journal.milliseconds_until_sync();
+    if (journal.needs_compaction()) {
+      int snapshot_wait = autosaver.milliseconds_until_due();
+      if (journal_wait == -1 || (snapshot_wait != -1
+                                 && snapshot_wait < journal_wait)) {
+        journal_wait = snapshot_wait;
+      }
+    }
+    for (int other_wait : { journal_wait, frame_wait > 0 ? frame_wait : -1 }) {
+      if (other_wait != -1 && (wait == -1 || other_wait < wait)) {
+        wait = other_wait;
+      }
+    }
+    timeout(wait);
+    return read_key();
+  }
+
+  // Read a key from curses, keeping count of the keys given back to it.
+  int read_key() {
+    int c = getch();
+    if (c == ERR) {
+      returned_keys = 0; // none are left
+    } else if (returned_keys > 0) {
+      --returned_keys;
+    }
+    return c;
+  }
+
+  // Read a key that answers a prompt. A paste is read whole and
+  // returned as its start, to be rejected, so that none of the keys in
+  // it are taken as answers.
+  int read_answer() {
+    int c = read_key();
+    if (KeyBindings::is_paste(c)) {
+      read_paste();
+    }
+    return c;
+  }
+
+  // Whether input c is text to insert in the edit buffer, rather than a
+  // key bound to a command.
+  bool is_text_input(int c) const {
+    return KeyBindings::is_enter(c) || c == '\t'
+      || (' ' <= c && c <= max_input_char()
+          && !KeyBindings::is_backspace(c));
+  }
+
+  // Insert the text input from c up to the first input that is not
+  // text, or that has not arrived yet, into the edit buffer as a single
+  // edit.
+  void handle_text_input(int c) {
+    std::string text;
+    timeout(0);
+    // the keys queued in curses come before the input still in the
+    // terminal, so enough keys are read through curses to empty its
+    // queue before the terminal is read directly
+    for (int keys = 0; is_text_input(c) && keys < CURSES_QUEUE_SIZE;
+         ++keys, c = read_key()) {
+      text += KeyBindings::is_enter(c) ? '\n' : static_cast<char>(c);
+    }
+    if (is_text_input(c)) {
+      text += KeyBindings::is_enter(c) ? '\n' : static_cast<char>(c);
+      read_text_input(text);
+    } else if (c != ERR) {
+      ungetch(c); // handled next
+      ++returned_keys;
+    }
+    clear_message();
+    editbuffer.text.insert(text.data(), text.size());
+    set_modified();
+  }
+
+  // Append the text input that has arrived to text. Since curses reads
+  // input a byte per system call, it is read from the terminal directly
+  // in chunks, and the input after the text is given back to curses.
+  void read_text_input(std::string &text) {
+    char chunk[INPUT_CHUNK_SIZE];
+    ssize_t count;
+    while ((count = read_input(chunk, sizeof(chunk), 0)) > 0) {
+      ssize_t i = 0;
+      for (; i < count && is_text_input(static_cast<unsigned char>(chunk[i]));
+           ++i) {
+        text += chunk[i] == '\r' ? '\n' : chunk[i];
+      }
+      if (i < count) {
+        give_back_input(std::string(chunk + i, count - i));
+        return;
+      }
+    }
+  }
+
+  // Read the text pasted after the start of a bracketed paste up to its
+  // end, with CR and CRLF converted to LF as when reading a file. The
+  // input after the paste is given back to curses.
+  std::string read_paste() {
+    // any of the paste given back to curses comes first, as its bytes
+    std::string text;
+    timeout(0);
+    int c;
+    while (returned_keys > 0 && (c = read_key()) != ERR) {
+      text += static_cast<char>(c);
+    }
+    std::size_t length = std::strlen(PASTE_END_SEQUENCE);
+    std::size_t from = 0, end;
+    char chunk[INPUT_CHUNK_SIZE];
+    while ((end = text.find(PASTE_END_SEQUENCE, from)) == std::string::npos) {
+      // the end may start in the text already read
+      from = text.size() - std::min(text.size(), length - 1);
+      ssize_t count = read_input(chunk, sizeof(chunk),
+                                 PASTE_WAIT_MILLISECONDS);
+      if (count == 0) { // the end was lost; keep what arrived
+        end = text.size();
+        break;
+      }
+      text.append(chunk, count);
+    }
+    if (end < text.size()) {
+      give_back_input(text.substr(end + length));
+      text.resize(end);
+    }
+    timeout(-1);
+    char last = '\0';
+    text.resize(FileLoader::normalize_newlines(&text[0], text.size(), last));
+    return text;
+  }
+
+  // Read up to size bytes of input from the terminal into bytes, waiting
+  // up to wait milliseconds for it to arrive. Returns the number of
+  // bytes read.
+  static ssize_t read_input(char *bytes, std::size_t size, int wait) {
+    pollfd input = { STDIN_FILENO, POLLIN, 0 };
+    if (poll(&input, 1, wait) <= 0) {
+      return 0;
+    }
+    return std::max<ssize_t>(0, read(STDIN_FILENO, bytes, size));
+  }
+
+  // Give bytes read from the terminal back to curses, as the keys that
+  // curses would have read from them, to be read next. An escape
+  // sequence cut off at the end is completed from further input. The
+  // bytes after the start of a paste are given back as they are.
+  void give_back_input(std::string bytes) {
+    std::vector<int> keys;
+    bool pasted = false;
+    for (std::size_t i = 0; i < bytes.size();) {
+      int key = static_cast<unsigned char>(bytes[i]);
+      std::size_t length = 1;
+      for (std::size_t end = i + 1; !pasted; ++end) {
+        if (end > bytes.size()) {
+          char more[INPUT_CHUNK_SIZE];
+          ssize_t count = read_input(more, sizeof(more), ESCDELAY);
+          if (count == 0) {
+            break;
+          }
+          bytes.append(more, count);
+        }
+        // positive for a key, 0 for none, or -1 for part of one
+        int code = key_defined(bytes.substr(i, end - i).c_str());
+        if (code > 0) {
+          key = code;
+          length = end - i;
+        }
+        if (code >= 0) {
+          break;
+        }
+      }
+      keys.push_back(key);
+      pasted = pasted || KeyBindings::is_paste(key);
+      i += length;
+    }
+    // curses returns the key given back last first
+    for (auto key = keys.rbegin(); key != keys.rend(); ++key) {
+      if (ungetch(*key) != ERR) {
+        ++returned_keys;
+      }
+    }
+  }
+
+  // Start journaling the edits to a file that has been loaded. Edits
+  // made while it loaded are kept in a snapshot of the buffer, and a
+  // journal being recovered is replayed onto the file first.
+  void loading_finished() {
+    if (recovering) {
+      recovering = false;
+      if (journal.recover()) {
+        set_modified();
+      }
+    } else if (modified) {
+      journal.start_from_snapshot();
+    } else {
+      journal.start();
+    }
+  }
+
+  // Sync the journal if it is due, compact it with a snapshot of the
+  // buffer written in the background when it grows too large, and
+  // report the first time that either fails.
+  void update_journal() {
+    journal.poll();
+    if (autosaver.pending()) {
+      if (autosaver.poll()) {
+        journal.finish_compaction(autosaver.error().empty());
+        if (!autosaver.error().empty()) {
+          set_message("ERROR: Snapshot failed (" + autosaver.error() + ")",
+                      "Snapshot FAILED");
+        }
+      }
+    } else if (journal.needs_compaction()) {
+      autosaver.set_path(journal.snapshot_path());
+      autosaver.poll();
+      if (autosaver.pending()) {
+        journal.begin_compaction();
+      }
+    }
+    if (journal.error() != journal_error) {
+      journal_error = journal.error();
+      if (!journal_error.empty()) {
+        set_message("ERROR: Journal failed (" + journal_error + ")",
+                    "Journal FAILED");
+      }
+    }
+  }
+
+  // Ask whether to recover the edits in the journal for the file, whose
+  // base has not changed since. Returns the answer.
+  bool handle_recover() {
+    minibuffer.set_prefix("Recover unsaved edits from "
+                          + shorten_string(Journal::path_for(filename))
+                          + "? (Y)es/(N)o ", "Recover? (Y/N) ");
+    clear_line(minibuffer);
+    render_minibuffer();
+    wrefresh(bottom_bar);
+    while (true) {
+      int c = read_answer();
+      if (c == 'y' || c == 'Y') {
+        set_message("Recovered unsaved edits; save to keep them",
+                    "Recovered");
+        return true;
+      } else if (c == 'n' || c == 'N' || KeyBindings::is_cancel(c)) {
+        return false;
+      } else {
+        beep(); // reject and alert the user
+      }
+    }
   }
 
   // Handle an input character in the edit buffer. Returns whether or
@@ -346,7 +849,11 @@ private:
     } else if (KeyBindings::is_goto(c)) {
       handle_goto();
     } else if (KeyBindings::is_find(c)) {
-      handle_find();
+      handle_find(false);
+    } else if (KeyBindings::is_find_backward(c)) {
+      handle_find(true);
+    } else if (KeyBindings::is_replace(c)) {
+      handle_replace();
     } else if (KeyBindings::is_cut(c)) {
       return handle_cut();
     } else if (KeyBindings::is_uncut(c)) {
@@ -359,10 +866,12 @@ private:
       move_page(2 - getmaxy(canvas));
     } else if (KeyBindings::is_pagedown(c)) {
       move_page(getmaxy(canvas) - 2);
+    } else if (KeyBindings::is_cancel(c) && loader) {
+      cancel_loading();
     } else {
       set_modified(handle_buffer_input(editbuffer, c,
                                        KeyBindings::MIN_CHAR,
-                                       KeyBindings::MAX_CHAR));
+                                       max_input_char()));
     }
     return true;
   }
@@ -394,15 +903,30 @@ private:
       buffer.text.insert('\n'); // convert to newline
       return true;
     } else if (KeyBindings::is_word_left(c)) {
-      // skip over alphanumeric characters
-      while (is_alphanumeric(buffer) && buffer.text.backward());
-      // skip over non-alphanumeric characters
-      while (!is_alphanumeric(buffer) && buffer.text.backward());
+      // skip back to the start of the word at the cursor, if any, and
+      // over the non-alphanumeric characters before it, to the last
+      // character of the previous word
+      if (is_alphanumeric(buffer)) {
+        buffer.text.skip_backward_while(word_class(true));
+      }
+      buffer.text.skip_backward_while(word_class(false));
+      buffer.text.backward();
     } else if (KeyBindings::is_word_right(c)) {
       // skip over alphanumeric characters
-      while (is_alphanumeric(buffer) && buffer.text.forward());
+      buffer.text.skip_forward_while(word_class(true));
       // skip over non-alphanumeric characters
-      while (!is_alphanumeric(buffer) && buffer.text.forward());
+      buffer.text.skip_forward_while(word_class(false));
+    } else if (KeyBindings::is_paste(c)) {
+      std::string text = read_paste();
+      if (&buffer == &minibuffer) {
+        // keep a single line of the characters accepted
+        text.erase(std::remove_if(text.begin(), text.end(), [=](char c) {
+          int input = static_cast<unsigned char>(c);
+          return input == '\n' || input < min_char || input > max_char;
+        }), text.end());
+      }
+      buffer.text.insert(text.data(), text.size());
+      return !text.empty();
     } else if (KeyBindings::is_ignore(c)) { // do nothing
     } else if (min_char <= c && c <= max_char) {
       buffer.text.insert(c);
@@ -413,15 +937,32 @@ private:
     return false;
   }
 
+  // Largest input character accepted as text. In UTF-8 mode, the bytes
+  // of multibyte characters arrive as separate inputs.
+  int max_input_char() const {
+    return utf8 ? MAX_UTF8_CHAR : KeyBindings::MAX_CHAR;
+  }
+
+  // Return the bytes that start alphanumeric characters, if alphanumeric
+  // is true, or the bytes that start any other characters.
+  static const TextBuffer::ByteClass & word_class(bool alphanumeric) {
+    static const std::array<TextBuffer::ByteClass, 2> classes = [] {
+      std::array<TextBuffer::ByteClass, 2> classes;
+      for (int c = 0; c < 256; ++c) {
+        classes[true][c] = (('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z')
+                            || ('0' <= c && c <= '9'));
+        classes[false][c] = !classes[true][c];
+      }
+      return classes;
+    }();
+    return classes[alphanumeric];
+  }
+
   // Determine whether the cursor is over an alphanumeric character.
   bool is_alphanumeric(Buffer &buffer) {
     return !buffer.text.is_at_end()
-      && ((buffer.text.data_at_cursor() >= 'a'
-           && buffer.text.data_at_cursor() <= 'z')
-          || (buffer.text.data_at_cursor() >= 'A'
-              && buffer.text.data_at_cursor() <= 'Z')
-          || (buffer.text.data_at_cursor() >= '0'
-              && buffer.text.data_at_cursor() <= '9'));
+      && word_class(true)[static_cast<unsigned char>(
+           buffer.text.data_at_cursor())];
   }
 
   // Read a line number in the minibuffer and go to that line.
@@ -432,8 +973,15 @@ private:
     std::string input = minibuffer.text.stringify();
     if (!input.empty()) {
       try {
-        int target = std::stoi(input);
-        goto_line(target);
+        Position target = std::stoll(input);
+        load_rows(target);
+        Position rows = editbuffer.text.row_count();
+        if (target > rows) { // clamp without scanning past the end
+          set_message("Only " + std::to_string(rows) + " lines",
+                      "Last line");
+          target = rows;
+        }
+        goto_line(std::max<Position>(target, 1));
       } catch (const std::out_of_range&) {
         set_message("ERROR: Invalid integer", "Invalid integer");
       }
@@ -442,17 +990,21 @@ private:
     }
   }
 
-  // Read user input in the minibuffer. Return whether input was
-  // not canceled.
-  bool get_minibuffer_input(int min_char, int max_char) {
-    render_canvas(false); // unhighlight cursor
-    wrefresh(canvas);
+  // Read user input in the minibuffer, first offering each key to
+  // handle_key, if given, which returns whether it consumed the key.
+  // Return whether input was not canceled.
+  bool get_minibuffer_input(
+    int min_char, int max_char,
+    const std::function<bool(int)> &handle_key = nullptr) {
+    render_all(false); // unhighlight cursor
     render_minibuffer();
     wrefresh(bottom_bar);
     int input;
-    while (!KeyBindings::is_enter(input = getch())
+    while (!KeyBindings::is_enter(input = read_key())
            && !KeyBindings::is_cancel(input)) {
-      handle_buffer_input(minibuffer, input, min_char, max_char, false);
+      if (!handle_key || !handle_key(input)) {
+        handle_buffer_input(minibuffer, input, min_char, max_char, false);
+      }
       render_minibuffer();
       wrefresh(bottom_bar);
     }
@@ -464,27 +1016,45 @@ private:
   }
 
   // Go to the start of a specific line in the text.
-  void goto_line(int target) {
-    editbuffer.text.move_to_row_start();
-    while (editbuffer.text.get_row() < target
-           && editbuffer.text.down());
-    while (editbuffer.text.get_row() > target
-           && editbuffer.text.up());
-  }
-
-  // Read a search string in the minibuffer, attempt to find it, and
-  // if it is found, go to that location.
-  void handle_find() {
-    std::string prefix = "Search (^N to cancel)";
-    if (!previous_search.empty()) {
-      prefix += " [" + previous_search + "]: ";
-    } else {
-      prefix += ": ";
-    }
-    minibuffer.set_prefix(prefix, "Search: ");
+  void goto_line(Position target) {
+    editbuffer.text.move_to_row(target, 0);
+  }
+
+  // Read a search string in the minibuffer, moving to its next match
+  // forward or backward from the cursor as it is typed, wrapping around
+  // at the end (or beginning) of the buffer. Regular expressions are
+  // only searched for once entered. If a match is found, stay there.
+  void handle_find(bool backward) {
+    TextBuffer &text = editbuffer.text;
+    Position origin = text.get_index();
+    // the result for each prefix of the pattern typed so far, to resume
+    // from when the pattern grows and to go back to when it shrinks
+    std::vector<SearchResult> results = { { "", origin, false } };
+    set_find_prompt(backward);
     clear_line(minibuffer);
-    if (!get_minibuffer_input(KeyBindings::MIN_CHAR,
-                              KeyBindings::MAX_CHAR)) {
+    auto handle_key = [&](int c) {
+      if (KeyBindings::is_regex_toggle(c)) {
+        regex_search = !regex_search;
+        set_find_prompt(backward);
+      } else {
+        handle_buffer_input(minibuffer, c, KeyBindings::MIN_CHAR,
+                            max_input_char(), false);
+      }
+      if (regex_search) {
+        text.move_to_index(origin);
+        set_message("", "");
+      } else {
+        update_incremental_search(results, backward);
+      }
+      render_canvas(false);
+      wrefresh(canvas);
+      render_message_bar();
+      wrefresh(message_bar);
+      return true;
+    };
+    if (!get_minibuffer_input(KeyBindings::MIN_CHAR, max_input_char(),
+                              handle_key)) {
+      text.move_to_index(origin);
       set_message("Canceled", "Canceled");
       return;
     }
@@ -492,80 +1062,336 @@ private:
     if (search.empty() && previous_search.empty()) {
       set_message("Canceled", "Canceled");
       return;
-    } else if (search.empty()) {
-      search = previous_search;
+    } else if (search.empty() || regex_search) {
+      find_next(search.empty() ? previous_search : search, backward);
+      return;
+    }
+    previous_search = search;
+    const SearchResult &result = results.back();
+    if (result.found == -1) {
+      text.move_to_index(origin);
+      set_message("\"" + shorten_string(search) + "\" not found",
+                  "Not found");
+    } else if (result.wrapped) {
+      set_message("Search wrapped", "Search wrapped");
+    } else {
+      set_message("", "");
+    }
+    if (result.found != -1) {
+      highlight_matches(search);
     }
+  }
+
+  // Bring an incremental search up to date with the pattern in the
+  // minibuffer, and move to the match for the longest prefix of the
+  // pattern that was found. The match for a longer pattern is at or
+  // after (or before, if backward) the match for its prefix, so the
+  // search resumes from there, and backspacing reuses earlier results.
+  void update_incremental_search(std::vector<SearchResult> &results,
+                                 bool backward) {
+    TextBuffer &text = editbuffer.text;
+    std::string pattern = minibuffer.text.stringify();
+    // keep only the results for prefixes of the pattern
+    while (pattern.compare(0, results.back().pattern.size(),
+                           results.back().pattern) != 0) {
+      results.pop_back();
+    }
+    const SearchResult &prefix = results.back();
+    if (prefix.pattern != pattern) {
+      SearchResult result = { pattern, -1, prefix.wrapped };
+      if (prefix.found != -1) {
+        Searcher searcher(backward ? std::string(pattern.rbegin(),
+                                                 pattern.rend())
+                          : pattern);
+        bool wrapped;
+        result.found = search_around([&](Position first, Position last) {
+          return backward ? rfind_in(text, searcher, first, last)
+            : find_in(text, searcher, first, last);
+        }, backward ? prefix.found + 1 : prefix.found, backward, wrapped,
+          [&]() { load_match(searcher); });
+        result.wrapped |= wrapped;
+      }
+      results.push_back(result);
+    }
+    auto found = std::find_if(results.rbegin(), results.rend(),
+                              [](const SearchResult &result) {
+                                return result.found != -1;
+                              });
+    text.move_to_index(found->found);
+    if (results.back().found == -1) {
+      set_message("Failing search", "Failing");
+    } else if (results.back().wrapped) {
+      set_message("Search wrapped", "Wrapped");
+    } else {
+      set_message("", "");
+    }
+  }
+
+  // Find the next match of search forward or backward from the cursor,
+  // wrapping around at the end (or beginning) of the buffer, and if it
+  // is found, go to that location.
+  void find_next(const std::string &search, bool backward) {
     previous_search = search;
 
-    // save old position, in case the string is not found
-    int old_row = editbuffer.text.get_row();
-    int old_column = editbuffer.text.get_column();
-    int old_index = editbuffer.text.get_index();
-    std::deque<char> search_deque{search.begin(), search.end()};
-    editbuffer.text.forward(); // skip current char
-    if (!find_helper(editbuffer.text, search_deque)) {
-      // try again from beginning
-      goto_line(1);
-      if (!find_helper(editbuffer.text, search_deque, old_index + 1)) {
-        set_message("\"" + shorten_string(search) + "\" not found",
-                    "Not found");
-        // restore old position
-        goto_line(old_row);
-        editbuffer.text.move_to_column(old_column);
+    // finds the first (or last, if backward) match starting in a range
+    TextBuffer &text = editbuffer.text;
+    std::function<Position(Position, Position)> find;
+    std::function<void()> load_rest = nullptr;
+    if (regex_search) {
+      Regex regex(search, utf8);
+      if (!regex.error().empty()) {
+        set_message("Bad regular expression: " + regex.error(),
+                    "Bad regex");
         return;
       }
+      find = [regex, backward, &text](Position first,
+                                      Position last) mutable {
+        Regex::Match match;
+        bool found = backward ? regex.rfind_in(text, first, last, match)
+          : regex.find_in(text, first, last, match);
+        return found ? match.start : -1;
+      };
+    } else {
+      Searcher searcher(backward ? std::string(search.rbegin(),
+                                               search.rend())
+                        : search);
+      find = [searcher, backward, &text](Position first, Position last) {
+        return backward ? rfind_in(text, searcher, first, last)
+          : find_in(text, searcher, first, last);
+      };
+      load_rest = [this, searcher]() { load_match(searcher); };
     }
-    // found string, need to move backwards to its beginning
-    for (std::size_t i = 1; i < search.size();
-         ++i, editbuffer.text.backward());
-    if (editbuffer.text.get_index() <= old_index) {
+
+    Position old_index = text.get_index();
+    bool wrapped;
+    Position found = search_around(
+      find, backward ? old_index : std::min(old_index + 1, text.size()),
+      backward, wrapped, load_rest);
+    if (found == -1) {
+      set_message("\"" + shorten_string(search) + "\" not found",
+                  "Not found");
+      return;
+    }
+    text.move_to_index(found);
+    if (wrapped) {
       set_message("Search wrapped", "Search wrapped");
     } else {
       set_message("", "");
     }
+    highlight_matches(search);
+  }
+
+  // Highlight every occurrence of a plain text search, indexing them in
+  // the background unless they already are. Regular expression matches
+  // are not highlighted.
+  void highlight_matches(const std::string &search) {
+    if (regex_search) {
+      matches.clear();
+    } else if (matches.pattern() != search) {
+      matches.start(search);
+    }
+  }
+
+  // Return a description of the match at the cursor and the number of
+  // matches of the last search, or an empty string if there are none.
+  std::string match_info() {
+    if (matches.pending()) {
+      return "counting matches ";
+    } else if (!matches.ready() || matches.positions().empty()) {
+      return "";
+    }
+    const std::vector<Position> &positions = matches.positions();
+    // a mapped file may have more matches after the part read so far
+    std::string total = std::to_string(positions.size()) + (mapped ? "+" : "");
+    auto match = std::lower_bound(positions.begin(), positions.end(),
+                                  editbuffer.text.get_index());
+    if (match == positions.end() || *match != editbuffer.text.get_index()) {
+      return total + " matches ";
+    }
+    return "match " + std::to_string(match - positions.begin() + 1)
+      + " of " + total + " ";
   }
 
-  // Search the given buffer for the string. If max_index is provided,
-  // the search ends upon exceeding that position by the size of the
-  // search string.
-  bool find_helper(TextBuffer &text, const std::deque<char> &search,
-                   int max_index = -1) {
-    int size = search.size();
-    std::deque<char> window;
-    for (; !text.is_at_end()
-           && (max_index == -1 || text.get_index() < max_index + size);
-         text.forward()) {
-      if (window.size() == search.size()) {
-        window.pop_front();
+  // Search with find, which returns the first (or last, if backward)
+  // match starting in a range, from index to one end of the buffer, then
+  // wrap around and search from the other end back to index. Returns
+  // the match or -1, and sets wrapped to whether the search wrapped.
+  // Searching past the end of a mapped file that has not been read
+  // completely reads up to its next match with load_match, if given, or
+  // else reads all of it.
+  Position search_around(const std::function<Position(Position,
+                                                      Position)> &find,
+                         Position index, bool backward, bool &wrapped,
+                         const std::function<void()> &load_match
+                         = nullptr) {
+    Position found = backward ? find(0, index)
+      : find(index, editbuffer.text.size());
+    if (found == -1 && mapped) {
+      if (backward || !load_match) {
+        finish_loading();
+      } else {
+        load_match();
       }
-      window.push_back(text.data_at_cursor());
-      if (window == search) {
-        return true;
+      if (!backward) {
+        found = find(index, editbuffer.text.size());
       }
     }
-    return false;
+    wrapped = (found == -1);
+    if (wrapped) {
+      found = backward ? find(index, editbuffer.text.size())
+        : find(0, index);
+    }
+    return found;
   }
 
-  // Clear the contents of the current line and return the contents.
-  std::string clear_line(Buffer &buffer) {
-    std::string line;
-    buffer.text.move_to_row_end();
-    if (buffer.text.forward()) {
-      line.push_back('\n');
-      buffer.text.backward();
-      buffer.text.remove();
+  // Set the minibuffer prompt for a search in the given direction (or
+  // for the text to replace) and the current search mode.
+  void set_find_prompt(bool backward, bool replace = false) {
+    std::string prefix = replace ? "Replace" : "Search";
+    if (regex_search) {
+      prefix = replace ? "Replace regex" : "Regex search";
+    }
+    if (backward) {
+      prefix += " backward";
+    }
+    prefix += regex_search ? " (^N to cancel, ^T for plain text)"
+      : " (^N to cancel, ^T for regex)";
+    if (!previous_search.empty()) {
+      prefix += " [" + previous_search + "]: ";
+    } else {
+      prefix += ": ";
+    }
+    std::string short_prefix = replace ? "Replace" : "Search";
+    if (regex_search) {
+      short_prefix = replace ? "Replace re" : "Regex";
+    }
+    short_prefix += backward ? " back: " : ": ";
+    minibuffer.set_prefix(prefix, short_prefix);
+  }
+
+  // Read a search string and its replacement in the minibuffer, then go
+  // through the matches from the cursor to the end of the buffer, asking
+  // whether to replace each one or all that remain. Replacing all copies
+  // the rest of the buffer out once and replaces every match in a
+  // single bulk edit.
+  void handle_replace() {
+    set_find_prompt(false, true);
+    clear_line(minibuffer);
+    auto toggle_regex = [&](int c) {
+      if (!KeyBindings::is_regex_toggle(c)) {
+        return false;
+      }
+      regex_search = !regex_search;
+      set_find_prompt(false, true);
+      return true;
+    };
+    if (!get_minibuffer_input(KeyBindings::MIN_CHAR, max_input_char(),
+                              toggle_regex)) {
+      set_message("Canceled", "Canceled");
+      return;
+    }
+    std::string search = minibuffer.text.stringify();
+    if (search.empty() && previous_search.empty()) {
+      set_message("Canceled", "Canceled");
+      return;
+    } else if (search.empty()) {
+      search = previous_search;
+    }
+    previous_search = search;
+    minibuffer.set_prefix("Replace with (^N to cancel): ", "With: ");
+    clear_line(minibuffer);
+    if (!get_minibuffer_input(KeyBindings::MIN_CHAR, max_input_char())) {
+      set_message("Canceled", "Canceled");
+      return;
+    }
+    std::string replacement = minibuffer.text.stringify();
+    finish_loading(); // the matches may be anywhere up to the end
+
+    // find the next match in the buffer, and all matches in a copy
+    TextBuffer &text = editbuffer.text;
+    Regex regex(regex_search ? search : "", utf8);
+    Searcher searcher(search);
+    if (!regex.error().empty()) {
+      set_message("Bad regular expression: " + regex.error(), "Bad regex");
+      return;
     }
-    bool moved = false;
-    while ((moved = buffer.text.backward())
-           && buffer.text.data_at_cursor() != '\n') {
-      line.push_back(buffer.text.data_at_cursor());
-      buffer.text.remove();
+    auto find_next_match = [&](Position from, Position &start,
+                               Position &end) {
+      if (regex_search) {
+        Regex::Match match;
+        bool found = regex.find_in(text, from, text.size(), match);
+        start = match.start;
+        end = match.end;
+        return found;
+      }
+      start = find_in(text, searcher, from, text.size());
+      end = start + search.size();
+      return start != -1;
+    };
+    MatchFinder find_all = substring_finder(searcher);
+    if (regex_search) {
+      find_all = [&](const char *first, const char *last, Position from,
+                     Position &start, Position &end) {
+        Regex::Match match;
+        bool found = regex.search(first, last, from, match);
+        start = match.start;
+        end = match.end;
+        return found;
+      };
     }
-    if (moved) {
-      buffer.text.forward(); // move back to start of line
+
+    Position replaced = 0;
+    Position start, end;
+    for (Position from = text.get_index();
+         from <= text.size() && find_next_match(from, start, end);) {
+      text.move_to_index(start);
+      minibuffer.set_prefix("Replace this match? (Y)es/(N)o/(A)ll/(C)ancel ",
+                            "Replace? (Y/N/A/C) ");
+      clear_line(minibuffer);
+      render_all(false); // unhighlight cursor
+      render_minibuffer();
+      wrefresh(bottom_bar);
+      int c = read_answer();
+      if (c == 'y' || c == 'Y') {
+        text.begin_batch();
+        text.erase(end - start);
+        text.insert(replacement.data(), replacement.size());
+        text.end_batch();
+        ++replaced;
+        from = text.get_index() + (start == end);
+      } else if (c == 'n' || c == 'N') {
+        from = end + (start == end);
+      } else if (c == 'a' || c == 'A') {
+        replaced += replace_all(text, start, find_all, replacement);
+        break;
+      } else if (c == 'c' || c == 'C' || KeyBindings::is_cancel(c)) {
+        break;
+      } else {
+        beep(); // reject and alert the user
+      }
     }
-    std::reverse(line.begin(), line.end());
-    return line;
+    clear_line(minibuffer);
+    set_modified(replaced > 0);
+    set_message("Replaced " + std::to_string(replaced)
+                + (replaced == 1 ? " occurrence" : " occurrences"),
+                "Replaced " + std::to_string(replaced));
+  }
+
+  // Clear the contents of the current line.
+  void clear_line(Buffer &buffer) {
+    std::string line;
+    cut_line(buffer, line);
+  }
+
+  // Cut the current line, including its newline, in one edit and append
+  // it to cut. Returns the number of bytes cut.
+  Position cut_line(Buffer &buffer, std::string &cut) {
+    buffer.text.move_to_row_end();
+    Position end = buffer.text.get_index() + !buffer.text.is_at_end();
+    buffer.text.move_to_row_start();
+    Position count = end - buffer.text.get_index();
+    buffer.text.cut(count, cut);
+    return count;
   }
 
   // Remove each line as long as CUT is input, saving them in
@@ -575,26 +1401,28 @@ private:
     std::string new_cut_value;
     int input = KeyBindings::CUT;
     while (KeyBindings::is_cut(input)) {
-      std::string line = clear_line(editbuffer);
-      if (line.empty()) {
+      if (cut_line(editbuffer, new_cut_value) == 0) {
         set_message("Nothing to cut", "Nothing to cut");
       }
-      new_cut_value += line;
       set_modified(!new_cut_value.empty()); // update status before
-      render_all();                         // re-rendering
-      input = getch();
+      // re-rendering, unless more cuts are typed ahead
+      timeout(0);
+      input = read_key();
+      if (input == ERR) {
+        render_all();
+        timeout(-1);
+        input = read_key();
+      }
     }
     if (!new_cut_value.empty()) {
-      cut_value = new_cut_value;
+      cut_value.swap(new_cut_value);
     }
     return handle_edit_input(input); // handle last user input
   }
 
   // Insert all characters from cut_value into the buffer.
   void handle_uncut() {
-    for (std::size_t i = 0; i < cut_value.size(); ++i) {
-      editbuffer.text.insert(cut_value[i]);
-    }
+    editbuffer.text.insert(cut_value.data(), cut_value.size());
     set_modified(!cut_value.empty());
     if (cut_value.empty()) {
       set_message("Nothing to uncut", "Nothing to uncut");
@@ -635,14 +1463,12 @@ private:
 
   // Handle pageup and pagedown events.
   void move_page(int offset) {
-    int column = editbuffer.text.get_column();
-    // move cursor first
-    while (editbuffer.text.get_row() < baseline + offset
-           && editbuffer.text.down()); // handle hitting the last row
-    while (editbuffer.text.get_row() > baseline + offset
-           && editbuffer.text.up()); // handle hitting the first row
-    // restore column
-    editbuffer.text.move_to_column(column);
+    // move cursor first, in the same column, stopping at the first or
+    // last row
+    editbuffer.text.move_to_row(
+      std::clamp<Position>(baseline + offset, 1,
+                           editbuffer.text.row_count()),
+      editbuffer.text.get_column());
     // set new baseline
     if (editbuffer.text.get_row() == 1) {
       baseline = 1;
@@ -666,13 +1492,14 @@ private:
 
   // Handle save dialogue.
   bool handle_save() {
+    finish_loading();
     minibuffer.set_prefix("File to write (^N to cancel): ", "Save as: ");
     clear_line(minibuffer);
     // add existing filename to minibuffer
     for (char ch : filename) {
       minibuffer.text.insert(ch);
     }
-    get_minibuffer_input(KeyBindings::MIN_CHAR, KeyBindings::MAX_CHAR);
+    get_minibuffer_input(KeyBindings::MIN_CHAR, max_input_char());
     std::string file_to_write = minibuffer.text.stringify();
     if (!file_to_write.empty()) {
       return write_file(file_to_write);
@@ -689,12 +1516,11 @@ private:
                             "exiting? (Y)es/(N)o/(C)ancel ",
                             "Save? (Y/N/C) ");
       clear_line(minibuffer);
-      render_canvas(false); // unhighlight cursor
-      wrefresh(canvas);
+      render_all(false); // unhighlight cursor
       render_minibuffer();
       wrefresh(bottom_bar);
       while (true) {
-        int c = getch();
+        int c = read_answer();
         if (c == 'y' || c == 'Y') {
           return handle_save();
         } else if (c == 'n' || c == 'N') {
@@ -719,10 +1545,18 @@ private:
        shorten_string(filename, std::min<int>(MAX_SHORT_STRING_LENGTH,
                                               getmaxx(top_bar) - 3)));
     file_info += " ";
+    if (large_file) {
+      file_info += "[large] ";
+    }
+    if (loader) {
+      file_info += "loading " + std::to_string(loaded_percentage()) + "% ";
+    }
     std::string position_info =
-      std::to_string(percentage) + "% ("
-      + std::to_string(editbuffer.text.get_row()) + ","
-      + std::to_string(editbuffer.text.get_column()) + ") ";
+      std::to_string(percentage) + "% (line "
+      + std::to_string(editbuffer.text.get_row()) + " of "
+      + row_count_info() + ", col "
+      + std::to_string(editbuffer.text.get_column()) + ") "
+      + match_info();
     reset_bar(top_bar);
     werase(overflow_bar);
     int info_length = std::strlen(femto_info) + file_info.size()
@@ -743,6 +1577,20 @@ private:
     wattroff(top_bar, A_REVERSE);
   }
 
+  // The number of lines in the file. Until a large file has all been
+  // read, it is estimated from the lines in the part read so far;
+  // otherwise only the lines read so far are counted.
+  std::string row_count_info() const {
+    Position rows = editbuffer.text.row_count();
+    std::int64_t read = loader ? loaded : mapped ? mapped->offset() : 0;
+    if (!loader && !mapped) {
+      return std::to_string(rows);
+    } else if (large_file && read > 0) {
+      return "~" + std::to_string(rows * file_bytes() / read);
+    }
+    return std::to_string(rows) + "+";
+  }
+
   // Reset given bar to be blank, with default position and attributes.
   void reset_bar(WINDOW *bar) {
     werase(bar);
@@ -766,14 +1614,23 @@ private:
       waddstr(message_bar, " ]");
       wattroff(message_bar, A_REVERSE);
     }
+    if (debug_overlay) {
+      // rendering counters for the last frame and in all, at the right
+      std::string counters = "rows " + std::to_string(frame_rows) + "/"
+        + std::to_string(total_rows) + " bytes "
+        + std::to_string(frame_bytes) + "/" + std::to_string(total_bytes);
+      mvwaddstr(message_bar, 0,
+                std::max<int>(0, getmaxx(message_bar) - counters.size() - 1),
+                counters.c_str());
+    }
   }
 
   // Render the command/minibuffer bar at the bottom.
   void render_bottom_bar() {
     reset_bar(bottom_bar);
     waddstr(bottom_bar,
-            " ^X exit | ^F find | ^A save | ^K cut | ^U uncut"
-            " | ^G goto | ^L redraw");
+            " ^X exit | ^F/^R find | ^E replace | ^A save | ^K cut"
+            " | ^U uncut | ^G goto");
     wattroff(bottom_bar, A_REVERSE);
   }
 
@@ -781,8 +1638,9 @@ private:
   void render_minibuffer() {
     reset_bar(bottom_bar);
     std::string data = minibuffer.text.stringify();
-    int old_column = minibuffer.text.get_column();
-    render_row(minibuffer, 1, old_column, true);
+    Position old_column = minibuffer.text.get_column();
+    TextBuffer::Reader reader = minibuffer.text.reader_at_row(1);
+    render_row(minibuffer, reader, 1, old_column, true);
     wattroff(bottom_bar, A_REVERSE);
     minibuffer.text.move_to_column(old_column); // restore position
     if (minibuffer.text.is_at_end()) {
@@ -791,126 +1649,293 @@ private:
   }
 
   // Render the canvas with the text data.
+  // Only the rows that changed since the canvas was last drawn are
+  // rendered: those changed by edits, the rows the cursor left and moved
+  // to, and the rows scrolled into view.
   void render_canvas(bool highlight_cursor = true) {
-    wmove(canvas, 0, 0);
-    werase(canvas);
     rebase();
+    TextBuffer &text = editbuffer.text;
+    CanvasState state = {
+      text.get_index(), text.get_row(), baseline, editbuffer.view_column,
+      highlight_cursor, matches.ready(), matches.pattern()
+    };
+    // a file that is still being read is measured against all of it
+    percentage = text.is_at_end() && !loader && !mapped ? 100
+      : static_cast<int>(100 * state.index
+                         / std::max<std::int64_t>(1, file_bytes()));
 
-    // save current position
-    int old_row = editbuffer.text.get_row();
-    int old_column = editbuffer.text.get_column();
-    percentage = editbuffer.text.is_at_end() ? 100 :
-      100LL * editbuffer.text.get_index() / editbuffer.text.size();
-    // display as many rows as fit on the canvas, starting at baseline
-    for (int row = baseline; row < baseline + getmaxy(canvas); ++row) {
-      goto_line(row); // move to start of target row
-      if (editbuffer.text.get_row() == row) { // guard against end
-        render_row(editbuffer, old_row, old_column, highlight_cursor);
-      }
+    Position height = getmaxy(canvas);
+    Position shift = baseline - drawn.baseline;
+    if (state.matches_ready != drawn.matches_ready
+        || state.pattern != drawn.pattern) {
+      canvas_damaged = true;
+    } else if (!canvas_damaged && shift != 0 && std::abs(shift) < height) {
+      // move the rows still in view, and render the rest
+      scrollok(canvas, true);
+      wscrl(canvas, shift);
+      scrollok(canvas, false);
+      damage_rows(shift > 0 ? baseline + height - shift : baseline,
+                  shift > 0 ? baseline + height - 1 : baseline - shift - 1);
+    } else if (shift != 0) {
+      canvas_damaged = true;
+      wclear(canvas); // required for some terminals
     }
 
-    // restore previous position
-    goto_line(old_row);
-    editbuffer.text.move_to_column(old_column);
+    // the rows to render, from the top of the canvas
+    std::vector<bool> render(height, canvas_damaged);
+    for (Position row = std::max(dirty_first, baseline);
+         row <= std::min(dirty_last, baseline + height - 1); ++row) {
+      render[row - baseline] = true;
+    }
+    if (state.index != drawn.index || state.highlight != drawn.highlight
+        || state.view_column != drawn.view_column) {
+      for (Position row : { drawn.row, state.row }) {
+        if (baseline <= row && row < baseline + height) {
+          render[row - baseline] = true;
+        }
+      }
+    }
 
-    if (highlight_cursor && editbuffer.text.is_at_end()) {
-      // add highlighted cursor at the end of the buffer
-      waddch(canvas, ' '|A_STANDOUT);
+    // read the rows in one pass from the start of the baseline row,
+    // skipping the rest of each row past the edge of the canvas and
+    // each row that is not rendered
+    bool at_end = text.is_at_end();
+    Position old_column = text.get_column();
+    TextBuffer::Reader reader = text.reader_at_row(baseline);
+    for (Position row = baseline; row < baseline + height; ++row) {
+      while (reader.get_row() < row && reader.next_row());
+      if (!render[row - baseline]) {
+        continue;
+      }
+      wmove(canvas, row - baseline, 0);
+      wclrtoeol(canvas);
+      ++rows_rendered;
+      if (reader.get_row() == row) { // guard against end
+        render_row(editbuffer, reader, state.row, old_column,
+                   highlight_cursor);
+        if (row == state.row && highlight_cursor && at_end) {
+          // add highlighted cursor at the end of the buffer
+          waddch(canvas, ' '|A_STANDOUT);
+        }
+      }
+    }
+    if (render[state.row - baseline]) {
+      // finding the view column of the cursor row moved the cursor
+      text.move_to_column(old_column);
     }
+
+    drawn = state;
+    drawn.view_column = editbuffer.view_column; // as computed for the row
+    canvas_damaged = false;
+    dirty_first = 1;
+    dirty_last = 0;
   }
 
-  // Handle character escaping when displaying to the given window.
-  void escape_char(WINDOW *window, char display, int attributes) {
-    if (display == '\b' || display == '\x7f') {
-      // special handling for backspace and delete
-      waddch(window, '^'|attributes);
-      waddch(window, (display == '\b' ? 'H' : '?')|attributes);
-    } else if (static_cast<unsigned char>(display) > KeyBindings::MAX_CHAR) {
-      // escape these with a backslash
-      waddch(window, '\\'|attributes);
-      char buf[11];
-      std::snprintf(buf, sizeof(buf) / sizeof(char), "%o",
-                    static_cast<unsigned char>(display));
-      for (std::size_t i = 0; i < std::strlen(buf); ++i) {
-        waddch(window, buf[i]|attributes);
-      }
+  // Mark the rows from first to last as changed since the canvas was
+  // last drawn.
+  void damage_rows(Position first, Position last) {
+    if (dirty_first > dirty_last) {
+      dirty_first = first;
+      dirty_last = last;
     } else {
-      waddch(window, display|attributes);
+      dirty_first = std::min(dirty_first, first);
+      dirty_last = std::max(dirty_last, last);
     }
   }
 
-  // Display a character in the window with proper highlighting.
-  void display_char(Buffer &buffer, char display, bool highlight) {
+  // Attributes of a character shown in the buffer's window: those of
+  // the window, highlighted if at the cursor, and underlined if it is
+  // part of a match of the last search.
+  chtype char_attributes(Buffer &buffer, bool highlight, bool match) {
+    chtype attributes = getattrs(buffer.window)
+      | (match ? A_UNDERLINE : A_NORMAL);
     if (highlight && buffer.reverse) {
-      wattroff(buffer.window, A_REVERSE);
-      escape_char(buffer.window, display, A_NORMAL);
-      wattron(buffer.window, A_REVERSE);
+      return attributes & ~A_REVERSE;
     } else if (highlight) {
-      escape_char(buffer.window, display, A_STANDOUT);
+      return attributes | A_STANDOUT;
+    }
+    return attributes;
+  }
+
+  // Add a byte to the row being batched, escaped as in the table of
+  // escapes. Tabs are expanded to the next tab stop.
+  void batch_byte(Buffer &buffer, char display, chtype attributes) {
+    unsigned char byte = static_cast<unsigned char>(display);
+    if (display == '\t') {
+      int x = getcurx(buffer.window) + row_cells.size();
+      row_cells.insert(row_cells.end(),
+                       char_widths[byte] - x % char_widths[byte],
+                       ' '|attributes);
+    } else {
+      for (char c : char_escapes[byte]) {
+        row_cells.push_back(static_cast<unsigned char>(c)|attributes);
+      }
+    }
+  }
+
+  // Display a character in the window with proper highlighting,
+  // underlined if it is part of a match of the last search. The
+  // character is added to the row being batched for the window.
+  void display_char(Buffer &buffer, char display, bool highlight,
+                    bool match = false) {
+    batch_byte(buffer, display, char_attributes(buffer, highlight, match));
+  }
+
+  // Display a possibly multibyte character. Printable UTF-8 sequences
+  // are passed to the terminal after the row batched so far, and any
+  // other bytes are escaped individually.
+  void display_char(Buffer &buffer, const std::string &display,
+                    bool highlight, bool match = false) {
+    chtype attributes = char_attributes(buffer, highlight, match);
+    if (display.size() == 1 || codepoint_width(decode_utf8(display)) < 0) {
+      for (char byte : display) {
+        batch_byte(buffer, byte, attributes);
+      }
     } else {
-      escape_char(buffer.window, display, A_NORMAL);
+      flush_row(buffer);
+      attr_t old_attributes = getattrs(buffer.window);
+      wattrset(buffer.window, attributes);
+      waddnstr(buffer.window, display.data(), display.size());
+      wattrset(buffer.window, old_attributes);
     }
   }
 
+  // Write the row batched for the buffer's window at its cursor in one
+  // call, cut off at the edge of the window, and move the cursor past
+  // it.
+  void flush_row(Buffer &buffer) {
+    if (!row_cells.empty()) {
+      int x, y;
+      getyx(buffer.window, y, x);
+      waddchnstr(buffer.window, row_cells.data(), row_cells.size());
+      wmove(buffer.window, y,
+            std::min<int>(x + row_cells.size(), getmaxx(buffer.window) - 1));
+      row_cells.clear();
+    }
+  }
+
+  // Column of the window at which the next character is displayed.
+  int window_column(Buffer &buffer) {
+    return getcurx(buffer.window) + row_cells.size();
+  }
+
   // Compute display width of a character written at column x.
-  int display_width(int x, char c) {
-    if (c == '\t') { // special case for tab
-      int width = char_widths[static_cast<unsigned char>(c)];
+  int display_width(int x, const std::string &c) {
+    if (c.size() > 1) { // UTF-8 sequence
+      int width = codepoint_width(decode_utf8(c));
+      if (width < 0) { // escaped byte by byte
+        width = 0;
+        for (char byte : c) {
+          width += char_widths[static_cast<unsigned char>(byte)];
+        }
+      }
+      return width;
+    } else if (c[0] == '\t') { // special case for tab
+      int width = char_widths[static_cast<unsigned char>(c[0])];
       return width - x % width;
     } else {
-      return char_widths[static_cast<unsigned char>(c)];
+      return char_widths[static_cast<unsigned char>(c[0])];
     }
   }
 
-  // Render the current buffer row in the window.
-  void render_row(Buffer &buffer, int cursor_row, int cursor_column,
+  // Decode a UTF-8 sequence of a lead byte and its continuation bytes.
+  // Returns INVALID_CODEPOINT if it does not encode a single codepoint.
+  static char32_t decode_utf8(const std::string &bytes) {
+    unsigned char lead = bytes[0];
+    std::size_t length = (lead < 0x80 ? 1 : lead < 0xC2 ? 0
+                          : lead < 0xE0 ? 2 : lead < 0xF0 ? 3
+                          : lead < 0xF5 ? 4 : 0);
+    if (length != bytes.size()) {
+      return INVALID_CODEPOINT;
+    }
+    char32_t codepoint = (length == 1 ? lead : lead & (0x7F >> length));
+    for (std::size_t i = 1; i < length; ++i) {
+      codepoint = (codepoint << 6) | (bytes[i] & 0x3F);
+    }
+    // reject overlong encodings, surrogates and values beyond Unicode
+    static const char32_t MINIMUM[] = { 0, 0, 0x80, 0x800, 0x10000 };
+    if (codepoint < MINIMUM[length] || codepoint > 0x10FFFF
+        || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+      return INVALID_CODEPOINT;
+    }
+    return codepoint;
+  }
+
+  // Render the row of the buffer at the reader in the window. Leaves
+  // the reader after the last character shown.
+  void render_row(Buffer &buffer, TextBuffer::Reader &reader,
+                  Position cursor_row, Position cursor_column,
                   bool highlight_cursor) {
-    int init_x, init_y;
-    getyx(buffer.window, init_y, init_x); // initial location
-    render_current_row_prefix(buffer, cursor_row, cursor_column);
-    for (int current_row = buffer.text.get_row();
-         !buffer.text.is_at_end()
-           && buffer.text.get_row() == current_row;
-         buffer.text.forward()) {
-      char c = buffer.text.data_at_cursor();
+    int init_y = getcury(buffer.window); // initial row
+    render_current_row_prefix(buffer, reader, cursor_row, cursor_column);
+    // walk the occurrences of the last search along with the row,
+    // rather than searching it
+    bool show_matches = (&buffer == &editbuffer && matches.ready());
+    Position match_size = matches.pattern().size();
+    std::vector<Position>::const_iterator next_match, last_match;
+    if (show_matches) {
+      const std::vector<Position> &positions = matches.positions();
+      next_match = std::lower_bound(positions.begin(), positions.end(),
+                                    reader.get_index() - match_size + 1);
+      last_match = positions.end();
+    }
+    for (Position current_row = reader.get_row();
+         !reader.is_at_end() && reader.get_row() == current_row;
+         reader.forward()) {
+      char c = reader.data();
+      std::string character = reader.character();
       // The display character is either ' ' (if it's a newline) or
       // the char. The display character is what gets highlighted if
       // the current position is at that point.
-      char display = (c == '\n' || c == '\r') ? ' ' : c;
+      std::string display = (c == '\n' || c == '\r') ? " " : character;
       bool highlight = false;
       if (highlight_cursor
-          && buffer.text.get_row() == cursor_row
-          && buffer.text.get_column() == cursor_column) {
+          && reader.get_row() == cursor_row
+          && reader.get_column() == cursor_column) {
         highlight = true;
       }
+      bool in_match = false;
+      if (show_matches) {
+        Position index = reader.get_index();
+        while (next_match != last_match && *next_match + match_size <= index) {
+          ++next_match;
+        }
+        in_match = (next_match != last_match && *next_match <= index);
+      }
 
-      int x, y;
-      getyx(buffer.window, y, x); // current location
-      if (c == '\n' && x == getmaxx(buffer.window) - 1 && y == init_y) {
+      int x = window_column(buffer); // current location
+      if (c == '\n' && x == getmaxx(buffer.window) - 1) {
         // Newline (edge case, newline at end of line)
-        display_char(buffer, display, highlight);
+        display_char(buffer, display, highlight, in_match);
       } else if (c == '\n' && x < getmaxx(buffer.window) - 1) {
         // Newline (common case)
-        display_char(buffer, display, highlight);
+        display_char(buffer, display, highlight, in_match);
+        flush_row(buffer);
         waddch(buffer.window, '\n');
-      } else if (display_width(x, c) >= getmaxx(buffer.window) - x) {
-        // Character goes off window
-        display_char(buffer, display, highlight);
+      } else if (display_width(x, character)
+                 >= getmaxx(buffer.window) - x) {
+        // Character goes off window: show what fits of an escaped one
+        if (character.size() == 1) {
+          display_char(buffer, display, highlight, in_match);
+        }
+        flush_row(buffer);
         wmove(buffer.window, init_y, getmaxx(buffer.window) - 1);
         waddch(buffer.window, buffer.right_overflow_marker);
         break;
       } else {
         // Show a regular character (common case)
-        display_char(buffer, display, highlight);
+        display_char(buffer, display, highlight, in_match);
       }
     }
+    flush_row(buffer);
   }
 
   // Render the start of a row if it is the current row. Moves the
-  // buffer to the first character to be displayed.
-  void render_current_row_prefix(Buffer &buffer, int cursor_row,
-                                 int cursor_column) {
-    if (cursor_row == buffer.text.get_row()) {
+  // reader to the first character to be displayed.
+  void render_current_row_prefix(Buffer &buffer, TextBuffer::Reader &reader,
+                                 Position cursor_row,
+                                 Position cursor_column) {
+    if (cursor_row == reader.get_row()) {
       // Show prefix
       std::string &prefix = buffer.get_prefix();
       for (std::size_t i = 0; i < prefix.size(); ++i) {
@@ -918,6 +1943,7 @@ private:
       }
       // Handle showing subset of current line if it is too long
       buffer.recompute_view_column(*this, cursor_row, cursor_column);
+      while (reader.get_column() < buffer.view_column && reader.forward());
       if (buffer.view_column != 0) {
         // not showing line start - add marker
         display_char(buffer, buffer.left_overflow_marker, false);
@@ -931,8 +1957,8 @@ private:
     if (editbuffer.text.get_row() < baseline
         || editbuffer.text.get_row() >= baseline + getmaxy(canvas)) {
       baseline =
-        std::max(1, editbuffer.text.get_row() - getmaxy(canvas) / 2);
-      wclear(canvas); // required for some terminals
+        std::max<Position>(1, editbuffer.text.get_row()
+                              - getmaxy(canvas) / 2);
     }
     if (editbuffer.text.get_row() != cursor_row) {
       editbuffer.view_column = 0;
@@ -940,42 +1966,138 @@ private:
     }
   }
 
-  // Read initial contents of the file.
-  void read_file() {
-    std::ifstream input(filename);
-    const std::streamsize SIZE = 128;
-    char arr[SIZE];
-    char last = '\0';
-    while (input) {
-      input.read(arr, SIZE);
-      for (std::streamsize i = 0; i < input.gcount(); ++i) {
-        // Convert CR and CRLF to just LF
-        if (last != '\r' || arr[i] != '\n') {
-          editbuffer.text.insert(arr[i] == '\r' ? '\n' : arr[i]);
-        }
-        last = arr[i];
+  // Start loading the given file into the buffer, mapping it instead
+  // if map_file is true, and load the first screen of it.
+  void open_file(const std::string &source, bool map_file) {
+    if (source.empty()) {
+      loading_finished();
+      return;
+    }
+    if (map_file) {
+      mapped.reset(new MappedFile(source));
+      if (!mapped->is_open()) { // e.g. a new file; read it as usual
+        mapped.reset();
       }
     }
-    // move to start of buffer
-    while (editbuffer.text.get_row() != 1) {
-      editbuffer.text.up();
+    if (!mapped) {
+      // show the first screen as soon as it has been read, and read the
+      // rest of the file while waiting for input
+      loader.reset(new FileLoader(source));
+      load_blocks();
     }
-    editbuffer.text.move_to_row_start();
   }
 
-  // Write the contents of the buffer to the file.
+  // Add blocks of the file being loaded to the end of the buffer, for
+  // up to LOAD_SLICE_MILLISECONDS or until the whole file is loaded.
+  void load_blocks() {
+    auto deadline = clock_t::now()
+      + std::chrono::milliseconds(LOAD_SLICE_MILLISECONDS);
+    std::string block;
+    while (loader && clock_t::now() < deadline) {
+      if (!loader->take(block)) { // a missing file starts out empty
+        loader.reset();
+        loading_finished();
+        return;
+      }
+      editbuffer.text.append(block.data(), block.size());
+      loaded += block.size();
+    }
+  }
+
+  // Load the rest of the file without waiting for input.
+  void finish_loading() {
+    if (loader || mapped) {
+      set_message("Loading " + shorten_string(filename), "Loading");
+      render_message_bar();
+      wrefresh(message_bar);
+    }
+    while (loader) {
+      load_blocks();
+    }
+    load_through(mapped ? mapped->size() : 0);
+  }
+
+  // Add the next block of a mapped file to the end of the buffer. The
+  // file is unmapped once it has all been read.
+  void load_mapped_block() {
+    std::string block;
+    if (mapped->take(block)) {
+      editbuffer.text.append(block.data(), block.size());
+    } else {
+      mapped.reset();
+      loading_finished();
+    }
+  }
+
+  // Read a mapped file until the buffer has at least the given number
+  // of rows, or the file has all been read.
+  void load_rows(Position rows) {
+    while (mapped && editbuffer.text.row_count() < rows) {
+      load_mapped_block();
+    }
+  }
+
+  // Read a mapped file up to at least the given offset in the file.
+  void load_through(std::int64_t offset) {
+    while (mapped && mapped->offset() < offset) {
+      load_mapped_block();
+    }
+  }
+
+  // Read a mapped file up to the end of the first occurrence of the
+  // searcher's pattern that is not entirely in the buffer yet, if there
+  // is one. Patterns typed in the minibuffer have no newlines, so they
+  // match the same bytes before and after newlines are converted.
+  void load_match(const Searcher &searcher) {
+    std::int64_t end = mapped->find_after(searcher);
+    if (end != -1) {
+      load_through(end);
+    }
+  }
+
+  // Stop loading the file. The buffer then holds only part of it, so it
+  // is no longer associated with the file, lest saving truncate it.
+  void cancel_loading() {
+    loader.reset();
+    set_message("Canceled loading; saving will ask for a new name",
+                "Load canceled");
+    filename.clear();
+    journal.set_filename(filename); // not journaled until it is saved
+    recovering = false;
+    status = "partial";
+  }
+
+  // The size of the file in bytes, including any part not read yet.
+  std::int64_t file_bytes() const {
+    return loader ? loader->file_size() : mapped ? mapped->size()
+      : editbuffer.text.size();
+  }
+
+  // How much of the file has been loaded, in percent.
+  int loaded_percentage() const {
+    std::int64_t size = loader->file_size();
+    // line endings may be shortened, so stop short of 100% until done
+    return size == 0 ? 0 : std::min<std::int64_t>(99, loaded * 100 / size);
+  }
+
+  // Write the contents of the buffer to the file. The buffer is written
+  // a block at a time to a temporary file, which is synced to disk and
+  // then renamed over the file, so the file is never left half written.
   bool write_file(const std::string &file_to_write) {
-    std::ofstream output(file_to_write);
-    std::string text = editbuffer.text.stringify();
-    if (output << text) {
+    std::string error;
+    if (save_text(editbuffer.text, file_to_write, true, error)) {
       filename = file_to_write;
+      autosaver.discard();
+      journal.stop();
+      journal.set_filename(filename);
+      journal.start();
       status = "saved";
       set_message("Wrote " + shorten_string(file_to_write),
                   "Wrote file");
       return true;
     } else {
       set_message("ERROR: Unable to write "
-                  + shorten_string(file_to_write),
+                  + shorten_string(file_to_write) + " (" + error + ")",
                   "Write FAILED");
     }
     return !modified;
@@ -983,17 +2105,59 @@ private:
 };
 
 
+// Parse a count such as 100, 64K, 16M or 2G into count. Returns whether
+// it is valid.
+static bool parse_count(const std::string &text, std::int64_t &count) {
+  std::size_t digits = 0;
+  while (digits < text.size()
+         && std::isdigit(static_cast<unsigned char>(text[digits]))) {
+    ++digits;
+  }
+  std::size_t unit = std::string("KMG").find(
+    std::toupper(static_cast<unsigned char>(text.c_str()[digits])));
+  // (without a suffix, the character looked up is the terminating null)
+  if (digits == 0 || digits > 12 || digits + 1 < text.size()
+      || (digits < text.size() && unit == std::string::npos)) {
+    return false;
+  }
+  int shift = digits < text.size() ? 10 * (unit + 1) : 0;
+  std::int64_t value = std::stoll(text.substr(0, digits));
+  if (value > (std::numeric_limits<std::int64_t>::max() >> shift)) {
+    return false; // too large to count in 64 bits
+  }
+  count = value << shift;
+  return true;
+}
+
 int main(int argc, char **argv) {
+  std::setlocale(LC_ALL, ""); // use the terminal's character set
   std::string filename = "";
   FemtoEditor::InputMode input_mode = FemtoEditor::FEMTO_INPUT_MODE;
-  if (argc > 1 && argv[1] == std::string("-r")) {
-    input_mode = FemtoEditor::RAW;
-    --argc;
-    ++argv;
-  } else if (argc > 1 && argv[1] == std::string("-t")) {
-    input_mode = FemtoEditor::TERMINAL;
-    --argc;
-    ++argv;
+  bool map_file = false;
+  bool debug_overlay = false;
+  std::int64_t frame_rate = FemtoEditor::FRAME_RATE;
+  std::int64_t large_bytes = FemtoEditor::LARGE_FILE_BYTES;
+  std::int64_t large_rows = FemtoEditor::LARGE_FILE_ROWS;
+  for (; argc > 1; --argc, ++argv) {
+    std::string arg = argv[1];
+    if (arg == "-r") {
+      input_mode = FemtoEditor::RAW;
+    } else if (arg == "-t") {
+      input_mode = FemtoEditor::TERMINAL;
+    } else if (arg == "-m") {
+      map_file = true;
+    } else if (arg == "-d") {
+      debug_overlay = true;
+    } else if ((arg == "-L" || arg == "-N") && argc > 2
+               && parse_count(argv[2], arg == "-L" ? large_bytes
+                                                   : large_rows)) {
+      --argc, ++argv; // skip the count
+    } else if (arg == "-f" && argc > 2 && parse_count(argv[2], frame_rate)
+               && frame_rate <= 1000) {
+      --argc, ++argv; // skip the rate
+    } else {
+      break;
+    }
   }
   if (argc > 1 && argv[1][0] == '-') {
     std::string arg = argv[1];
@@ -1004,9 +2168,18 @@ int main(int argc, char **argv) {
     info += "\nAuthor: Amir Kamil";
     std::string usage = "Usage: ";
     usage += argv[0];
-    usage += " [-r|-t] [filename]";
+    usage += " [-r|-t] [-m] [-L size] [-N lines] [-d] [-f rate]"
+      " [filename]";
     usage += "\n\t-r\tenable raw input mode";
     usage += "\n\t-t\tenable terminal input mode";
+    usage += "\n\t-m\tmap the file and read it only as far as it is viewed";
+    usage += "\n\t-L\tuse large-file mode for files of at least size bytes";
+    usage += "\n\t\t(K, M or G for KiB, MiB or GiB; default 64M)";
+    usage += "\n\t-N\tuse large-file mode for files of at least this many";
+    usage += "\n\t\tlines (default 1000000)";
+    usage += "\n\t-d\tshow the rows rendered and bytes sent to the terminal";
+    usage += "\n\t-f\trender at most rate frames per second (default 60;";
+    usage += "\n\t\t0 for no limit)";
     if (arg != "-h" && arg != "-v" && arg != "--help") {
       std::cout << "Unknown option " << arg << "\n";
       exit_value = 1;
@@ -1017,5 +2190,6 @@ int main(int argc, char **argv) {
   if (argc > 1) {
     filename = argv[1];
   }
-  FemtoEditor fedit(filename, input_mode);
+  FemtoEditor fedit(filename, input_mode, map_file, large_bytes,
+                    large_rows, debug_overlay, frame_rate);
 }
@@ -0,0 +1,128 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <pty.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "Journal.hpp"
+#include "unit_test_framework.hpp"
+
+using namespace std;
+
+static const char *FILENAME = "femto_tests.tmp";
+
+// Returns the contents of filename.
+static string read_file(const string &filename) {
+  ifstream input(filename, ios::binary);
+  ostringstream contents;
+  contents << input.rdbuf();
+  return contents.str();
+}
+
+// Returns whether filename exists.
+static bool exists(const string &filename) {
+  return ifstream(filename).good();
+}
+
+// femto.exe running on FILENAME in a pseudo-terminal.
+class Session {
+public:
+  Session() {
+    winsize size = { 24, 80, 0, 0 };
+    pid = forkpty(&terminal, nullptr, nullptr, &size);
+    if (pid == 0) {
+      setenv("TERM", "xterm", 1);
+      execl("./femto.exe", "femto.exe", FILENAME, nullptr);
+      _exit(127);
+    }
+    drain(500);
+  }
+
+  ~Session() {
+    if (is_running()) {
+      kill(pid, SIGKILL);
+      waitpid(pid, nullptr, 0);
+    }
+    close(terminal);
+  }
+
+  // Types keys, and reads the output until the screen settles.
+  void type(const string &keys) {
+    ASSERT_EQUAL(write(terminal, keys.data(), keys.size()),
+                 static_cast<ssize_t>(keys.size()));
+    drain(300);
+  }
+
+  // Returns whether femto has not exited.
+  bool is_running() {
+    return exited == 0 && (exited = waitpid(pid, nullptr, WNOHANG)) == 0;
+  }
+
+  // Returns whether femto exits within seconds.
+  bool exits_within(int seconds) {
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(seconds);
+    while (is_running() && chrono::steady_clock::now() < deadline) {
+      drain(10);
+    }
+    return !is_running();
+  }
+
+private:
+  pid_t pid;
+  int terminal;
+  pid_t exited = 0;
+
+  // Reads the output until there is none for quiet milliseconds.
+  void drain(int quiet) {
+    char output[4096];
+    pollfd ready = { terminal, POLLIN, 0 };
+    while (poll(&ready, 1, quiet) > 0
+           && read(terminal, output, sizeof(output)) > 0);
+  }
+};
+
+// Creates FILENAME with the given contents, and removes any journal
+// left for it.
+static void reset(const string &original) {
+  remove(Journal::path_for(FILENAME).c_str());
+  ofstream(FILENAME) << original;
+}
+
+TEST(test_paste_does_not_answer_exit_prompt) {
+  reset("base\n");
+  {
+    Session femto;
+    femto.type("x");
+    femto.type("\x18"); // ^X: save before exiting?
+    femto.type("\x1b[200~n\x1b[201~");
+    ASSERT_TRUE(femto.is_running());
+    ASSERT_TRUE(exists(Journal::path_for(FILENAME)));
+    femto.type("c"); // the prompt is still there to cancel
+    femto.type("\x18");
+    femto.type("n");
+    ASSERT_TRUE(femto.exits_within(5));
+  }
+  ASSERT_EQUAL(read_file(FILENAME), "base\n");
+  remove(FILENAME);
+}
+
+TEST(test_typed_ahead_input_keeps_its_order) {
+  reset("");
+  {
+    Session femto;
+    // curses reads ahead to match the unknown escape sequences
+    femto.type("\x1b[5xab\x1b[5xcd");
+    femto.type("\x01\r"); // ^A: save
+    femto.type("\x18");
+    ASSERT_TRUE(femto.exits_within(5));
+  }
+  ASSERT_EQUAL(read_file(FILENAME), "\x1b[5xab\x1b[5xcd");
+  remove(FILENAME);
+}
+
+TEST_MAIN()
@@ -18,8 +18,9 @@ using namespace std;
 // EFFECTS:  Prints out the characters from text in the range [start,
 //           end) to cout, replacing newline characters with the \n
 //           escape sequence.
-void print_range(string text, int start, int end) {
-  for (int i = start; i < end; ++i) {
+void print_range(const string &text, TextBuffer::Position start,
+                 TextBuffer::Position end) {
+  for (TextBuffer::Position i = start; i < end; ++i) {
     if (text[i] == '\n') {
       cout << "\\n";
     } else {
@@ -35,7 +36,7 @@ void print_range(string text, int start, int end) {
 //           prints out the cursor row and column.
 void visualize_buffer(TextBuffer &buffer) {
   string text = buffer.stringify();
-  int index = buffer.get_index();
+  TextBuffer::Position index = buffer.get_index();
   print_range(text, 0, index);
   cout << '|';
   print_range(text, index, text.size());